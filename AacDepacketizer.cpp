@@ -0,0 +1,339 @@
+
+#include "AacDepacketizer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef _MSC_VER
+#define strcasecmp _stricmp
+#else
+#include <strings.h>
+#endif
+
+// samples per AAC access unit, the RTP clock of MPEG4-GENERIC audio is the sample rate
+#define AAC_FRAME_SAMPLES   1024
+
+// AUs are small, 13-bit sizes cap them at 8 KB
+#define AAC_DEPACKETIZER_RESERVE    (16 * 1024)
+
+namespace
+{
+    /* MSB first reader over the AU header section */
+    class BitReader
+    {
+    public:
+        BitReader(const unsigned char* data, size_t bits)
+            : _data(data), _bits(bits), _offset(0)
+        {
+        }
+
+        inline bool Available(size_t bits) const { return _offset + bits <= _bits; }
+
+        /* Whether a read or skip went past the end, the bits beyond it read as 0 */
+        inline bool Overrun() const { return _offset > _bits; }
+
+        uint32_t Read(int bits)
+        {
+            uint32_t value = 0;
+            for (int i = 0; i < bits; ++i)
+            {
+                uint32_t bit = (_offset < _bits) ? ((_data[_offset >> 3] >> (7 - (_offset & 7))) & 1) : 0;
+                value = (value << 1) | bit;
+                ++_offset;
+            }
+            return value;
+        }
+
+        inline void Skip(size_t bits) { _offset += bits; }
+
+    private:
+        const unsigned char* _data;
+        size_t _bits;
+        size_t _offset;
+    };
+}
+
+AacDepacketizer::AacDepacketizer(const std::string& fmtp)
+    : RtpDepacketizer(FORMAT_ANNEXB, AAC_DEPACKETIZER_RESERVE)
+    , _size_length(0), _index_length(0), _index_delta_length(0)
+    , _cts_delta_length(0), _dts_delta_length(0)
+    , _random_access_indication(0), _stream_state_indication(0)
+    , _auxiliary_data_size_length(0), _constant_size(0)
+    , _constant_duration(AAC_FRAME_SAMPLES)
+    , _fragment(false), _fragment_timestamp(0), _fragment_size(0)
+    , _skipping(false), _skip_timestamp(0)
+{
+    parseFmtp(fmtp);
+}
+
+AacDepacketizer::~AacDepacketizer()
+{
+}
+
+void AacDepacketizer::Reset()
+{
+    RtpDepacketizer::Reset();
+    _fragment = false;
+    _skipping = false;
+}
+
+void AacDepacketizer::parseFmtp(const std::string& fmtp)
+{
+    // RFC3640.4.1 the AU header fields default to absent, only the AAC modes fix their sizes
+    std::string mode;
+    int size_length = -1;
+    int index_length = -1;
+    int index_delta_length = -1;
+
+    std::string::size_type off = 0;
+    while (off < fmtp.size())
+    {
+        std::string::size_type end = fmtp.find(';', off);
+        if (std::string::npos == end)
+        {
+            end = fmtp.size();
+        }
+
+        std::string::size_type eq = fmtp.find('=', off);
+        if (eq < end)
+        {
+            std::string::size_type key_start = fmtp.find_first_not_of(" \t", off);
+            std::string::size_type key_end = fmtp.find_last_not_of(" \t", eq - 1);
+            if (key_start < eq && key_end >= key_start && key_end < eq)
+            {
+                std::string key = fmtp.substr(key_start, key_end - key_start + 1);
+                std::string text = fmtp.substr(eq + 1, end - eq - 1);
+                int value = atoi(text.c_str());
+
+                if (strcasecmp(key.c_str(), "mode") == 0)
+                {
+                    std::string::size_type value_start = text.find_first_not_of(" \t");
+                    std::string::size_type value_end = text.find_last_not_of(" \t");
+                    mode = (std::string::npos == value_start) ? std::string() : text.substr(value_start, value_end - value_start + 1);
+                }
+                else if (strcasecmp(key.c_str(), "sizelength") == 0)
+                    size_length = value;
+                else if (strcasecmp(key.c_str(), "indexlength") == 0)
+                    index_length = value;
+                else if (strcasecmp(key.c_str(), "indexdeltalength") == 0)
+                    index_delta_length = value;
+                else if (strcasecmp(key.c_str(), "ctsdeltalength") == 0)
+                    _cts_delta_length = value;
+                else if (strcasecmp(key.c_str(), "dtsdeltalength") == 0)
+                    _dts_delta_length = value;
+                else if (strcasecmp(key.c_str(), "randomaccessindication") == 0)
+                    _random_access_indication = value;
+                else if (strcasecmp(key.c_str(), "streamstateindication") == 0)
+                    _stream_state_indication = value;
+                else if (strcasecmp(key.c_str(), "auxiliarydatasizelength") == 0)
+                    _auxiliary_data_size_length = value;
+                else if (strcasecmp(key.c_str(), "constantsize") == 0)
+                    _constant_size = value;
+                else if (strcasecmp(key.c_str(), "constantduration") == 0 && value > 0)
+                    _constant_duration = (uint32_t)value;
+            }
+        }
+        off = end + 1;
+    }
+
+    // RFC3640.3.3.5/3.3.6, whatever the fmtp names explicitly still wins
+    if (strcasecmp(mode.c_str(), "AAC-hbr") == 0)
+    {
+        _size_length = 13;
+        _index_length = 3;
+        _index_delta_length = 3;
+    }
+    else if (strcasecmp(mode.c_str(), "AAC-lbr") == 0)
+    {
+        _size_length = 6;
+        _index_length = 2;
+        _index_delta_length = 2;
+    }
+    if (size_length >= 0)
+        _size_length = size_length;
+    if (index_length >= 0)
+        _index_length = index_length;
+    if (index_delta_length >= 0)
+        _index_delta_length = index_delta_length;
+}
+
+void AacDepacketizer::depacketize(const unsigned char* payload, int length, uint32_t timestamp, bool marker)
+{
+    if (_skipping)
+    {
+        if (timestamp == _skip_timestamp)
+        {
+            // the rest of an AU that lost a fragment
+            return;
+        }
+        _skipping = false;
+    }
+
+    if (_fragment && timestamp != _fragment_timestamp)
+    {
+        // the last fragment of the previous AU never arrived
+        dropFragment();
+    }
+
+    /* RFC3640.3.2.1 AU headers, their smallest size with every delta flagged absent. The flags are
+    * there whenever their delta length is set, the first header has the index, later ones the index delta */
+    int flag_bits = ((_cts_delta_length > 0) ? 1 : 0) + ((_dts_delta_length > 0) ? 1 : 0)
+        + (_random_access_indication ? 1 : 0) + _stream_state_indication;
+    int first_header_bits = _size_length + _index_length + flag_bits;
+    int later_header_bits = _size_length + _index_delta_length + flag_bits;
+
+    // the AU header section is left out when every header field is empty
+    bool has_headers = first_header_bits > 0 || later_header_bits > 0;
+    size_t offset = 0;
+    size_t header_section_bits = 0;
+    if (has_headers)
+    {
+        if (length < 2)
+        {
+            markCorrupted();
+            return;
+        }
+        header_section_bits = (payload[0] << 8) | payload[1];
+        offset = 2 + (header_section_bits + 7) / 8;
+        if (offset > (size_t)length)
+        {
+            markCorrupted();
+            return;
+        }
+    }
+
+    /* RFC3640.3.2.2 auxiliary section, skipped */
+    if (_auxiliary_data_size_length > 0)
+    {
+        if (offset + (_auxiliary_data_size_length + 7) / 8 > (size_t)length)
+        {
+            markCorrupted();
+            return;
+        }
+        BitReader aux(payload + offset, (length - offset) * 8);
+        size_t aux_bits = aux.Read(_auxiliary_data_size_length);
+        offset += (_auxiliary_data_size_length + aux_bits + 7) / 8;
+        if (offset > (size_t)length)
+        {
+            markCorrupted();
+            return;
+        }
+    }
+
+    const unsigned char* data = payload + offset;
+    size_t remain = length - offset;
+
+    if (!has_headers)
+    {
+        // no AU headers: constantsize AUs back to back, or the whole payload is one AU
+        size_t au_size = (_constant_size > 0) ? (size_t)_constant_size : remain;
+        uint32_t au_timestamp = timestamp;
+        while (remain >= au_size && au_size > 0)
+        {
+            append(data, au_size);
+            finishFrame(au_timestamp, true);
+            au_timestamp += _constant_duration;
+            data += au_size;
+            remain -= au_size;
+        }
+        if (remain > 0)
+        {
+            markCorrupted();
+        }
+        return;
+    }
+
+    BitReader headers(payload + 2, header_section_bits);
+    uint32_t au_timestamp = timestamp;
+    bool first = true;
+    while (headers.Available(first ? first_header_bits : later_header_bits))
+    {
+        size_t au_size = (_size_length > 0) ? headers.Read(_size_length) : (size_t)_constant_size;
+        if (first)
+        {
+            headers.Skip(_index_length);
+        }
+        else
+        {
+            // AUs of a packet are consecutive unless interleaving is in use
+            au_timestamp += (headers.Read(_index_delta_length) + 1) * _constant_duration;
+        }
+
+        /* the CTS-flag is 0 in the first header, a flagged delta follows its flag */
+        if (_cts_delta_length > 0 && headers.Read(1))
+        {
+            headers.Skip(_cts_delta_length);
+        }
+        if (_dts_delta_length > 0 && headers.Read(1))
+        {
+            headers.Skip(_dts_delta_length);
+        }
+        if (_random_access_indication)
+        {
+            headers.Skip(1);
+        }
+        headers.Skip(_stream_state_indication);
+        if (headers.Overrun())
+        {
+            markCorrupted();
+            return;
+        }
+
+        if (first && au_size > remain)
+        {
+            // RFC3640.3.2.3 fragmented AU: a single AU header carrying the size of the whole AU
+            if (!_fragment)
+            {
+                _fragment = true;
+                _fragment_timestamp = timestamp;
+                _fragment_size = au_size;
+            }
+            append(data, remain);
+
+            if (frameSize() >= _fragment_size || marker)
+            {
+                if (frameSize() != _fragment_size)
+                {
+                    // not the AU the header announced, e.g. it started at a fragment after a lost first one
+                    dropFragment();
+                    return;
+                }
+                _fragment = false;
+                finishFrame(timestamp, true);
+            }
+            return;
+        }
+
+        if (au_size > remain)
+        {
+            markCorrupted();
+            return;
+        }
+
+        append(data, au_size);
+        finishFrame(au_timestamp, true);
+        data += au_size;
+        remain -= au_size;
+        first = false;
+    }
+}
+
+void AacDepacketizer::onLoss()
+{
+    // every AU stands alone, a lost packet only takes its own AUs with it
+    if (_fragment)
+    {
+        // whatever else arrives of the AU in progress can not complete it any more
+        _skipping = true;
+        _skip_timestamp = _fragment_timestamp;
+    }
+    dropFragment();
+}
+
+void AacDepacketizer::dropFragment()
+{
+    if (_fragment)
+    {
+        truncateFrame(0);
+        _fragment = false;
+    }
+}
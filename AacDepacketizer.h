@@ -0,0 +1,63 @@
+
+/*****************************************************************************
+*                                                                            *
+*  @file     AacDepacketizer.h                                               *
+*  @brief    MPEG4-GENERIC AAC RTP depacketizer declaration (RFC3640)        *
+*                                                                            *
+*  Details.                                                                  *
+*    The AU header section is read with the sizelength, indexlength and      *
+*    indexdeltalength fmtp parameters, every access unit becomes a frame     *
+*    with its own timestamp. An AU larger than one packet is reassembled     *
+*    from the fragments that share its RTP timestamp.                        *
+*                                                                            *
+*----------------------------------------------------------------------------*
+*  Remark   :                                                                *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef __AAC_DEPACKETIZER_HEADER_H__
+#define __AAC_DEPACKETIZER_HEADER_H__
+
+#include "RtpDepacketizer.h"
+
+class AacDepacketizer : public RtpDepacketizer
+{
+public:
+    /* fmtp: the a=fmtp parameters, AU header fields missing from it are absent unless mode=AAC-hbr or AAC-lbr fixes them */
+    explicit AacDepacketizer(const std::string& fmtp);
+    ~AacDepacketizer();
+
+    void Reset();
+
+protected:
+    void depacketize(const unsigned char* payload, int length, uint32_t timestamp, bool marker);
+    void onLoss();
+
+private:
+    void parseFmtp(const std::string& fmtp);
+    void dropFragment();
+
+private:
+    /* RFC3640.4.1 */
+    int _size_length;
+    int _index_length;
+    int _index_delta_length;
+    int _cts_delta_length;
+    int _dts_delta_length;
+    int _random_access_indication;
+    int _stream_state_indication;
+    int _auxiliary_data_size_length;
+    int _constant_size;
+    uint32_t _constant_duration;
+
+    // AU in progress across packets
+    bool _fragment;
+    uint32_t _fragment_timestamp;
+    size_t _fragment_size;
+
+    // packets of this timestamp are dropped, they belong to an AU that lost a fragment
+    bool _skipping;
+    uint32_t _skip_timestamp;
+};
+
+#endif
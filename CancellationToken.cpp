@@ -0,0 +1,54 @@
+
+#include "CancellationToken.h"
+
+#include <algorithm>
+
+CancellationToken::Subscription::Subscription(CancellationToken* token, EventNotifier* notifier)
+    : _token(token), _notifier(notifier)
+{
+    if (_token)
+    {
+        std::lock_guard<std::mutex> lg(_token->_locker);
+        _token->_notifiers.push_back(_notifier);
+    }
+}
+
+CancellationToken::Subscription::~Subscription()
+{
+    if (_token)
+    {
+        std::lock_guard<std::mutex> lg(_token->_locker);
+        std::vector<EventNotifier*>& notifiers = _token->_notifiers;
+        std::vector<EventNotifier*>::iterator it = std::find(notifiers.begin(), notifiers.end(), _notifier);
+        if (it != notifiers.end())
+        {
+            notifiers.erase(it);
+        }
+    }
+}
+
+CancellationToken::CancellationToken()
+    : _cancelled(false), _locker(), _notifiers()
+{
+}
+
+CancellationToken::~CancellationToken()
+{
+}
+
+void CancellationToken::Cancel()
+{
+    // set before waking, a woken wait checks Cancelled in its ready predicate
+    _cancelled.store(true, std::memory_order_seq_cst);
+
+    std::lock_guard<std::mutex> lg(_locker);
+    for (EventNotifier* notifier : _notifiers)
+    {
+        notifier->Notify();
+    }
+}
+
+void CancellationToken::Reset()
+{
+    _cancelled.store(false, std::memory_order_seq_cst);
+}
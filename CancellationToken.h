@@ -0,0 +1,64 @@
+
+/*****************************************************************************
+*                                                                            *
+*  @file     CancellationToken.h                                             *
+*  @brief    Cross-thread cancellation of blocking waits                     *
+*                                                                            *
+*  Details.                                                                  *
+*    A blocking call subscribes its EventNotifier to the token for the       *
+*    length of the wait, Cancel wakes every subscribed wait at once.         *
+*                                                                            *
+*----------------------------------------------------------------------------*
+*  Remark   :                                                                *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef __CANCELLATION_TOKEN_HEADER_H__
+#define __CANCELLATION_TOKEN_HEADER_H__
+
+#include "EventNotifier.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+class CancellationToken
+{
+public:
+    /* Keeps a notifier subscribed to Cancel for its lifetime, a null token is allowed */
+    class Subscription
+    {
+    public:
+        Subscription(CancellationToken* token, EventNotifier* notifier);
+        ~Subscription();
+
+    private:
+        CancellationToken* _token;
+        EventNotifier* _notifier;
+
+    private:
+        Subscription(const Subscription& rhs);
+        Subscription& operator=(const Subscription& rhs);
+    };
+
+public:
+    CancellationToken();
+    ~CancellationToken();
+
+    /* Safe from any thread, waits started afterwards return right away until Reset */
+    void Cancel();
+    void Reset();
+
+    inline bool Cancelled() const { return _cancelled.load(std::memory_order_seq_cst); }
+
+private:
+    std::atomic<bool> _cancelled;
+    std::mutex _locker;
+    std::vector<EventNotifier*> _notifiers;
+
+private:
+    CancellationToken(const CancellationToken& rhs);
+    CancellationToken& operator=(const CancellationToken& rhs);
+};
+
+#endif
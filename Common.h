@@ -1,15 +1,35 @@
-
-#ifndef __RTSP_RTP_COMMON_HEADER_H__
-#define __RTSP_RTP_COMMON_HEADER_H__
-
-#include <string>
+
+#ifndef __RTSP_RTP_COMMON_HEADER_H__
+#define __RTSP_RTP_COMMON_HEADER_H__
+
+#include <string>
+
+#ifdef _MSC_VER
+#include <winsock2.h>
+#else
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+typedef int SOCKET;
+#define INVALID_SOCKET -1
+
+#endif
 
 typedef struct _Endpoint
 {
     unsigned short rtp_port = 0;
     unsigned short rtcp_port = 0;
     std::string address;
-} Endpoint;
-
-#endif
-
+} Endpoint;
+
+typedef struct _MulticastEndpoint
+{
+    unsigned short rtp_port = 0;
+    unsigned short rtcp_port = 0;
+    std::string group;          // IPv4 or IPv6 group address
+    std::string source;         // sender of a source-specific group, empty joins any source
+    std::string interface;      // local interface name to join on, empty lets the routing table decide
+} MulticastEndpoint;
+
+#endif
+
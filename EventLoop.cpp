@@ -0,0 +1,187 @@
+
+#include "EventLoop.h"
+
+#ifdef RTSP_COROUTINE
+
+#define EVENT_LOOP_MAX_READY    64
+
+bool EventLoop::IoAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    _waiter.handle = handle;
+    if (_loop->_poller.Add(_waiter.fd, &_waiter, _writable) < 0)
+    {
+        // not suspending, await_resume reports the error right away
+        _failed = true;
+        return false;
+    }
+    _waiter.polled = true;
+    if (_timeout_ms >= 0)
+    {
+        _loop->addTimer(&_waiter, _timeout_ms);
+    }
+    return true;
+}
+
+void EventLoop::SleepAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    _waiter.handle = handle;
+    _loop->addTimer(&_waiter, _ms);
+}
+
+EventLoop::EventLoop()
+    : _poller(), _tasks(), _timers(), _locker(), _posted(), _stopped(false)
+{
+}
+
+EventLoop::~EventLoop()
+{
+    Destroy();
+}
+
+int EventLoop::Create()
+{
+    _stopped = false;
+    return _poller.Create();
+}
+
+void EventLoop::Destroy()
+{
+    // suspended tasks are destroyed with their frames, nothing resumes them any more
+    _tasks.clear();
+    _timers.clear();
+    {
+        std::lock_guard<std::mutex> lg(_locker);
+        _posted.clear();
+    }
+    _poller.Destroy();
+}
+
+void EventLoop::Spawn(Task<void> task)
+{
+    if (!task.Done())
+    {
+        Post(task._handle);
+        _tasks.push_back(std::move(task));
+    }
+}
+
+int EventLoop::Run()
+{
+    void* ready[EVENT_LOOP_MAX_READY];
+    while (true)
+    {
+        resumePosted();
+        resumeExpired();
+
+        for (std::list<Task<void>>::iterator it = _tasks.begin(); it != _tasks.end();)
+        {
+            it = it->Done() ? _tasks.erase(it) : std::next(it);
+        }
+
+        {
+            std::lock_guard<std::mutex> lg(_locker);
+            if (_stopped || (_tasks.empty() && _posted.empty()))
+            {
+                _stopped = false;
+                return 0;
+            }
+            if (!_posted.empty())
+            {
+                continue;
+            }
+        }
+
+        int count = _poller.Wait(ready, EVENT_LOOP_MAX_READY, nextTimeout());
+        if (count < 0)
+        {
+            return -1;
+        }
+        for (int i = 0; i < count; ++i)
+        {
+            Waiter* waiter = static_cast<Waiter*>(ready[i]);
+            cancel(waiter);
+            waiter->handle.resume();
+        }
+    }
+}
+
+void EventLoop::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lg(_locker);
+        _stopped = true;
+    }
+    _poller.Wakeup();
+}
+
+void EventLoop::Post(std::coroutine_handle<> handle)
+{
+    {
+        std::lock_guard<std::mutex> lg(_locker);
+        _posted.push_back(handle);
+    }
+    _poller.Wakeup();
+}
+
+void EventLoop::addTimer(Waiter* waiter, int ms)
+{
+    waiter->timer = true;
+    waiter->expiry = _timers.emplace(std::chrono::steady_clock::now() + std::chrono::milliseconds(ms), waiter);
+}
+
+void EventLoop::cancel(Waiter* waiter)
+{
+    if (waiter->polled)
+    {
+        _poller.Remove(waiter->fd);
+        waiter->polled = false;
+    }
+    if (waiter->timer)
+    {
+        _timers.erase(waiter->expiry);
+        waiter->timer = false;
+    }
+}
+
+void EventLoop::resumePosted()
+{
+    std::vector<std::coroutine_handle<>> posted;
+    {
+        std::lock_guard<std::mutex> lg(_locker);
+        posted.swap(_posted);
+    }
+    for (std::coroutine_handle<> handle : posted)
+    {
+        handle.resume();
+    }
+}
+
+void EventLoop::resumeExpired()
+{
+    TimePoint now = std::chrono::steady_clock::now();
+    while (!_timers.empty() && _timers.begin()->first <= now)
+    {
+        Waiter* waiter = _timers.begin()->second;
+        waiter->timed_out = waiter->polled;
+        cancel(waiter);
+        waiter->handle.resume();
+    }
+}
+
+int EventLoop::nextTimeout() const
+{
+    if (_timers.empty())
+    {
+        return -1;
+    }
+
+    // round up, waking a little early would only spin another round
+    std::chrono::steady_clock::duration left = _timers.begin()->first - std::chrono::steady_clock::now();
+    if (left <= std::chrono::steady_clock::duration::zero())
+    {
+        return 0;
+    }
+    return (int)std::chrono::duration_cast<std::chrono::milliseconds>(left + std::chrono::milliseconds(1) - std::chrono::nanoseconds(1)).count();
+}
+
+#endif // RTSP_COROUTINE
@@ -0,0 +1,277 @@
+
+/*****************************************************************************
+*                                                                            *
+*  @file     EventLoop.h                                                     *
+*  @brief    Single-threaded coroutine event loop (C++20)                    *
+*                                                                            *
+*  Details.                                                                  *
+*    Task<T> is a lazily started coroutine a caller co_awaits. EventLoop     *
+*    resumes coroutines waiting for socket readiness, a timer or a Post      *
+*    from another thread, all on the one thread that calls Run.              *
+*    Only compiled where the compiler implements coroutines.                 *
+*                                                                            *
+*----------------------------------------------------------------------------*
+*  Remark   :                                                                *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef __EVENT_LOOP_HEADER_H__
+#define __EVENT_LOOP_HEADER_H__
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define RTSP_COROUTINE  1
+#endif
+#endif
+
+#ifdef RTSP_COROUTINE
+
+#include "Common.h"
+#include "EventPoller.h"
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <list>
+#include <map>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// what an I/O wait resumes with when its timeout passed first
+#define EVENT_LOOP_TIMEOUT  -2
+
+template <typename T>
+class Task;
+
+namespace detail
+{
+    struct TaskPromiseBase
+    {
+        // resumed when the task finishes, none for a task spawned on the loop
+        std::coroutine_handle<> continuation;
+
+        struct FinalAwaiter
+        {
+            bool await_ready() const noexcept { return false; }
+
+            template <typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+            {
+                std::coroutine_handle<> continuation = handle.promise().continuation;
+                return continuation ? continuation : std::noop_coroutine();
+            }
+
+            void await_resume() const noexcept { }
+        };
+
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        FinalAwaiter final_suspend() const noexcept { return {}; }
+
+        // errors are return values in this library, an exception escaping a task is a bug
+        void unhandled_exception() const noexcept { std::terminate(); }
+    };
+
+    template <typename T>
+    struct TaskPromise : public TaskPromiseBase
+    {
+        T value{};
+
+        Task<T> get_return_object();
+        void return_value(T result) { value = std::move(result); }
+    };
+
+    template <>
+    struct TaskPromise<void> : public TaskPromiseBase
+    {
+        Task<void> get_return_object();
+        void return_void() const { }
+    };
+}
+
+template <typename T = void>
+class Task
+{
+public:
+    typedef detail::TaskPromise<T> promise_type;
+    typedef std::coroutine_handle<promise_type> Handle;
+
+public:
+    explicit Task(Handle handle = nullptr) : _handle(handle) { }
+    Task(Task&& rhs) noexcept : _handle(std::exchange(rhs._handle, nullptr)) { }
+
+    Task& operator=(Task&& rhs) noexcept
+    {
+        if (this != &rhs)
+        {
+            if (_handle)
+            {
+                _handle.destroy();
+            }
+            _handle = std::exchange(rhs._handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~Task()
+    {
+        if (_handle)
+        {
+            _handle.destroy();
+        }
+    }
+
+    inline bool Done() const { return !_handle || _handle.done(); }
+
+    /* co_await starts the task and resumes the caller once it returned */
+    bool await_ready() const noexcept { return !_handle || _handle.done(); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+    {
+        _handle.promise().continuation = caller;
+        return _handle;
+    }
+
+    T await_resume()
+    {
+        if constexpr (!std::is_void<T>::value)
+        {
+            return std::move(_handle.promise().value);
+        }
+    }
+
+private:
+    friend class EventLoop;
+    Handle _handle;
+
+private:
+    Task(const Task& rhs);
+    Task& operator=(const Task& rhs);
+};
+
+namespace detail
+{
+    template <typename T>
+    inline Task<T> TaskPromise<T>::get_return_object()
+    {
+        return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+    }
+
+    inline Task<void> TaskPromise<void>::get_return_object()
+    {
+        return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+    }
+}
+
+class EventLoop
+{
+public:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+
+private:
+    struct Waiter
+    {
+        std::coroutine_handle<> handle;
+        SOCKET fd = INVALID_SOCKET;
+        bool polled = false;
+        bool timed_out = false;
+        bool timer = false;
+        std::multimap<TimePoint, Waiter*>::iterator expiry;
+    };
+
+public:
+    /* co_await loop.Readable(fd, timeout_ms): 0 once the socket is ready, -1 if it can not be watched,
+    * EVENT_LOOP_TIMEOUT when timeout_ms passed first */
+    class IoAwaiter
+    {
+    public:
+        IoAwaiter(EventLoop* loop, SOCKET fd, bool writable, int timeout_ms)
+            : _loop(loop), _writable(writable), _timeout_ms(timeout_ms), _failed(false), _waiter()
+        {
+            _waiter.fd = fd;
+        }
+        ~IoAwaiter() { _loop->cancel(&_waiter); }
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle);
+        int await_resume() const noexcept { return _failed ? -1 : (_waiter.timed_out ? EVENT_LOOP_TIMEOUT : 0); }
+
+    private:
+        EventLoop* _loop;
+        bool _writable;
+        int _timeout_ms;
+        bool _failed;
+        Waiter _waiter;
+    };
+
+    /* co_await loop.Sleep(ms) */
+    class SleepAwaiter
+    {
+    public:
+        SleepAwaiter(EventLoop* loop, int ms) : _loop(loop), _ms(ms), _waiter() { }
+        ~SleepAwaiter() { _loop->cancel(&_waiter); }
+
+        bool await_ready() const noexcept { return _ms <= 0; }
+        void await_suspend(std::coroutine_handle<> handle);
+        void await_resume() const noexcept { }
+
+    private:
+        EventLoop* _loop;
+        int _ms;
+        Waiter _waiter;
+    };
+
+public:
+    EventLoop();
+    ~EventLoop();
+
+    int Create();
+    void Destroy();
+
+    /* Run 'task' on the loop, it starts with the next round of Run. The loop owns it from here */
+    void Spawn(Task<void> task);
+
+    /* Resume coroutines until every spawned task finished or Stop was called, on the calling thread only.
+    * return:
+    *    -1 if waiting for events failed
+    * */
+    int Run();
+
+    /* Make Run return after the current round, safe from any thread */
+    void Stop();
+
+    /* Resume 'handle' on the loop thread, safe from any thread */
+    void Post(std::coroutine_handle<> handle);
+
+    /* timeout_ms: -1 waits forever */
+    inline IoAwaiter Readable(SOCKET fd, int timeout_ms = -1) { return IoAwaiter(this, fd, false, timeout_ms); }
+    inline IoAwaiter Writable(SOCKET fd, int timeout_ms = -1) { return IoAwaiter(this, fd, true, timeout_ms); }
+    inline SleepAwaiter Sleep(int ms) { return SleepAwaiter(this, ms); }
+
+private:
+    void addTimer(Waiter* waiter, int ms);
+
+    /* Stop watching for 'waiter', also when its coroutine is destroyed while suspended */
+    void cancel(Waiter* waiter);
+    void resumePosted();
+    void resumeExpired();
+    int nextTimeout() const;
+
+private:
+    EventPoller _poller;
+    std::list<Task<void>> _tasks;
+    std::multimap<TimePoint, Waiter*> _timers;
+
+    std::mutex _locker;
+    std::vector<std::coroutine_handle<>> _posted;
+    bool _stopped;
+
+private:
+    EventLoop(const EventLoop& rhs);
+    EventLoop& operator=(const EventLoop& rhs);
+};
+
+#endif // RTSP_COROUTINE
+
+#endif
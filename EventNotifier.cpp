@@ -0,0 +1,89 @@
+
+#include "EventNotifier.h"
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+#endif
+
+// longest single sleep, both the futex and the condition variable take a relative timeout
+#define EVENT_NOTIFIER_MAX_WAIT_HOURS   24
+
+EventNotifier::EventNotifier()
+    : _sequence(0), _waiters(0)
+#ifndef __linux__
+    , _locker(), _condition()
+#endif
+{
+}
+
+EventNotifier::~EventNotifier()
+{
+}
+
+void EventNotifier::Notify()
+{
+    // pairs with the fetch_add on _waiters in WaitUntil: either the waiter sees the data or we see the waiter
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_waiters.load(std::memory_order_seq_cst) == 0)
+    {
+        return;
+    }
+
+    _sequence.fetch_add(1, std::memory_order_seq_cst);
+
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_sequence), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+    std::lock_guard<std::mutex> lg(_locker);
+    _condition.notify_all();
+#endif
+}
+
+bool EventNotifier::WaitUntil(const std::chrono::steady_clock::time_point& deadline, const std::function<bool()>& ready)
+{
+    while (true)
+    {
+        uint32_t sequence = _sequence.load(std::memory_order_seq_cst);
+        if (ready())
+        {
+            return true;
+        }
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+        {
+            return false;
+        }
+
+        // announce ourselves before the final check, a Notify after it either sees us or changes _sequence
+        _waiters.fetch_add(1, std::memory_order_seq_cst);
+        if (ready())
+        {
+            _waiters.fetch_sub(1, std::memory_order_seq_cst);
+            return true;
+        }
+
+        std::chrono::nanoseconds left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now);
+        if (left > std::chrono::hours(EVENT_NOTIFIER_MAX_WAIT_HOURS))
+        {
+            // an open-ended deadline, keep the relative timeout in range and go around again
+            left = std::chrono::hours(EVENT_NOTIFIER_MAX_WAIT_HOURS);
+        }
+#ifdef __linux__
+        struct timespec timeout;
+        timeout.tv_sec = (time_t)(left.count() / 1000000000);
+        timeout.tv_nsec = (long)(left.count() % 1000000000);
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_sequence), FUTEX_WAIT_PRIVATE, sequence, &timeout, nullptr, 0);
+#else
+        {
+            std::unique_lock<std::mutex> ul(_locker);
+            _condition.wait_for(ul, left, [this, sequence]() { return _sequence.load() != sequence; });
+        }
+#endif
+        _waiters.fetch_sub(1, std::memory_order_seq_cst);
+    }
+}
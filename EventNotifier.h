@@ -0,0 +1,64 @@
+
+/*****************************************************************************
+*                                                                            *
+*  @file     EventNotifier.h                                                 *
+*  @brief    Lock-free producer to consumer wakeup                           *
+*                                                                            *
+*  Details.                                                                  *
+*    Notify costs a fence and a load while nobody waits; a waiting           *
+*    consumer sleeps on a futex (condition variable on other platforms).     *
+*                                                                            *
+*----------------------------------------------------------------------------*
+*  Remark   :                                                                *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef __EVENT_NOTIFIER_HEADER_H__
+#define __EVENT_NOTIFIER_HEADER_H__
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+#ifndef __linux__
+#include <mutex>
+#include <condition_variable>
+#endif
+
+#include <stdint.h>
+
+class EventNotifier
+{
+public:
+    EventNotifier();
+    ~EventNotifier();
+
+    /* Wake every waiter, safe from any thread */
+    void Notify();
+
+    /* Sleep until 'ready' returns true or the deadline passes.
+    * return:
+    *    the last result of 'ready'
+    * */
+    bool WaitUntil(const std::chrono::steady_clock::time_point& deadline, const std::function<bool()>& ready);
+
+    inline bool WaitFor(const std::chrono::milliseconds& timeout, const std::function<bool()>& ready)
+    {
+        return WaitUntil(std::chrono::steady_clock::now() + timeout, ready);
+    }
+
+private:
+    std::atomic<uint32_t> _sequence;
+    std::atomic<int> _waiters;
+
+#ifndef __linux__
+    std::mutex _locker;
+    std::condition_variable _condition;
+#endif
+
+private:
+    EventNotifier(const EventNotifier& rhs);
+    EventNotifier& operator=(const EventNotifier& rhs);
+};
+
+#endif
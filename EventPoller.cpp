@@ -0,0 +1,233 @@
+
+#include "EventPoller.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#else
+#include <chrono>
+#endif
+
+#include <errno.h>
+
+#define EVENT_POLLER_MAX_EVENTS     64
+
+#ifndef __linux__
+// select() has no portable cross-thread wakeup, so a blocking Wait is cut into slices of this length
+#define EVENT_POLLER_SLICE_MS       20
+#endif
+
+EventPoller::EventPoller()
+#ifdef __linux__
+    : _epoll_fd(-1), _wakeup_fd(-1)
+#else
+    : _locker(), _watches(), _wakeup(false)
+#endif
+{
+}
+
+EventPoller::~EventPoller()
+{
+    Destroy();
+}
+
+#ifdef __linux__
+
+int EventPoller::Create()
+{
+    if (_epoll_fd >= 0)
+    {
+        return 0;
+    }
+
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (_epoll_fd < 0)
+    {
+        return -1;
+    }
+
+    _wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_wakeup_fd < 0)
+    {
+        Destroy();
+        return -1;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr; // nullptr marks the wakeup event
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wakeup_fd, &ev) < 0)
+    {
+        Destroy();
+        return -1;
+    }
+    return 0;
+}
+
+void EventPoller::Destroy()
+{
+    if (_wakeup_fd >= 0)
+    {
+        close(_wakeup_fd);
+        _wakeup_fd = -1;
+    }
+    if (_epoll_fd >= 0)
+    {
+        close(_epoll_fd);
+        _epoll_fd = -1;
+    }
+}
+
+int EventPoller::Add(SOCKET fd, void* userdata, bool writable)
+{
+    struct epoll_event ev;
+    ev.events = writable ? EPOLLOUT : EPOLLIN;
+    ev.data.ptr = userdata;
+    return epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+int EventPoller::Remove(SOCKET fd)
+{
+    struct epoll_event ev = {};
+    return epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, &ev);
+}
+
+int EventPoller::Wait(void** ready, int max, int timeout_ms)
+{
+    struct epoll_event events[EVENT_POLLER_MAX_EVENTS];
+    if (max > EVENT_POLLER_MAX_EVENTS)
+    {
+        max = EVENT_POLLER_MAX_EVENTS;
+    }
+
+    int n = epoll_wait(_epoll_fd, events, max, timeout_ms);
+    if (n < 0)
+    {
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    int count = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        if (events[i].data.ptr)
+        {
+            ready[count++] = events[i].data.ptr;
+        }
+        else
+        {
+            uint64_t value = 0;
+            while (read(_wakeup_fd, &value, sizeof(value)) == sizeof(value));
+        }
+    }
+    return count;
+}
+
+void EventPoller::Wakeup()
+{
+    uint64_t value = 1;
+    if (_wakeup_fd >= 0)
+    {
+        ssize_t res = write(_wakeup_fd, &value, sizeof(value));
+        (void)res;
+    }
+}
+
+#else
+
+int EventPoller::Create()
+{
+    return 0;
+}
+
+void EventPoller::Destroy()
+{
+    std::lock_guard<std::mutex> lg(_locker);
+    _watches.clear();
+}
+
+int EventPoller::Add(SOCKET fd, void* userdata, bool writable)
+{
+    std::lock_guard<std::mutex> lg(_locker);
+    _watches.push_back(Watch{ fd, userdata, writable });
+    return 0;
+}
+
+int EventPoller::Remove(SOCKET fd)
+{
+    std::lock_guard<std::mutex> lg(_locker);
+    for (std::vector<Watch>::iterator it = _watches.begin(); it != _watches.end(); ++it)
+    {
+        if (it->fd == fd)
+        {
+            _watches.erase(it);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int EventPoller::Wait(void** ready, int max, int timeout_ms)
+{
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (true)
+    {
+        fd_set rset, wset;
+        FD_ZERO(&rset);
+        FD_ZERO(&wset);
+
+        SOCKET maxfd = 0;
+        std::vector<Watch> watches;
+        {
+            std::lock_guard<std::mutex> lg(_locker);
+            if (_wakeup)
+            {
+                _wakeup = false;
+                return 0;
+            }
+            watches = _watches;
+        }
+        for (const Watch& watch : watches)
+        {
+            FD_SET(watch.fd, watch.writable ? &wset : &rset);
+            if (watch.fd > maxfd)
+            {
+                maxfd = watch.fd;
+            }
+        }
+
+        struct timeval tval;
+        tval.tv_sec = 0;
+        tval.tv_usec = EVENT_POLLER_SLICE_MS * 1000;
+
+        int n = select((int)maxfd + 1, &rset, &wset, NULL, &tval);
+        if (n < 0)
+        {
+            return (errno == EINTR) ? 0 : -1;
+        }
+        if (n > 0)
+        {
+            int count = 0;
+            for (const Watch& watch : watches)
+            {
+                if (count < max && FD_ISSET(watch.fd, watch.writable ? &wset : &rset))
+                {
+                    ready[count++] = watch.userdata;
+                }
+            }
+            return count;
+        }
+        if (timeout_ms >= 0 && std::chrono::steady_clock::now() >= deadline)
+        {
+            return 0;
+        }
+    }
+}
+
+void EventPoller::Wakeup()
+{
+    std::lock_guard<std::mutex> lg(_locker);
+    _wakeup = true;
+}
+
+#endif
@@ -0,0 +1,71 @@
+
+/*****************************************************************************
+*                                                                            *
+*  @file     EventPoller.h                                                   *
+*  @brief    Socket readiness poller declaration                             *
+*                                                                            *
+*  Details.                                                                  *
+*    Thin wrapper over epoll (select() on other platforms) that blocks until *
+*    one of the registered sockets is readable or Wakeup() is called.        *
+*                                                                            *
+*----------------------------------------------------------------------------*
+*  Remark   :                                                                *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef __EVENT_POLLER_HEADER_H__
+#define __EVENT_POLLER_HEADER_H__
+
+#include "Common.h"
+
+#ifndef __linux__
+#include <mutex>
+#include <vector>
+#endif
+
+class EventPoller
+{
+public:
+    EventPoller();
+    ~EventPoller();
+
+    int Create();
+    void Destroy();
+
+    /* userdata is handed back by Wait when fd becomes readable, or writable if asked for */
+    int Add(SOCKET fd, void* userdata, bool writable = false);
+    int Remove(SOCKET fd);
+
+    /* Block until a registered socket is ready, Wakeup() is called or timeout_ms elapses(-1 = infinite).
+    * ready:
+    *    receives the userdata of every readable socket, at most 'max' of them
+    * return:
+    *    number of entries written to 'ready', 0 on timeout or wakeup, -1 on error
+    * */
+    int Wait(void** ready, int max, int timeout_ms);
+
+    /* Make a concurrent or the next Wait return immediately, safe from any thread */
+    void Wakeup();
+
+private:
+#ifdef __linux__
+    int _epoll_fd;
+    int _wakeup_fd;
+#else
+    struct Watch
+    {
+        SOCKET fd;
+        void* userdata;
+        bool writable;
+    };
+    std::mutex _locker;
+    std::vector<Watch> _watches;
+    bool _wakeup;
+#endif
+
+private:
+    EventPoller(const EventPoller& rhs);
+    EventPoller& operator=(const EventPoller& rhs);
+};
+
+#endif
@@ -0,0 +1,40 @@
+
+#include "H264Depacketizer.h"
+
+/* RFC6184.5.4 */
+#define H264_NAL_IDR        5
+#define H264_NAL_SPS        7
+#define H264_NAL_STAP_A     24
+#define H264_NAL_FU_A       28
+
+// STAP-B, MTAP and FU-B only exist in interleaved mode which is never negotiated
+const RtpDepacketizer::NalSyntax H264Depacketizer::s_syntax = { 1, 0, 0x1F, 1, H264_NAL_STAP_A, H264_NAL_FU_A };
+
+H264Depacketizer::H264Depacketizer(Format format)
+    : RtpDepacketizer(format, RTP_DEPACKETIZER_RESERVE, &s_syntax)
+{
+}
+
+H264Depacketizer::~H264Depacketizer()
+{
+}
+
+bool H264Depacketizer::IsKeyframeStart(const unsigned char* payload, int length) const
+{
+    return isNalKeyframeStart(payload, length);
+}
+
+void H264Depacketizer::depacketize(const unsigned char* payload, int length, uint32_t timestamp, bool marker)
+{
+    depacketizeNal(payload, length, timestamp, marker);
+}
+
+bool H264Depacketizer::isKeyframeNal(unsigned char type) const
+{
+    return H264_NAL_IDR == type;
+}
+
+bool H264Depacketizer::startsKeyframeNal(unsigned char type) const
+{
+    return H264_NAL_IDR == type || H264_NAL_SPS == type;
+}
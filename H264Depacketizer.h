@@ -0,0 +1,39 @@
+
+/*****************************************************************************
+*                                                                            *
+*  @file     H264Depacketizer.h                                              *
+*  @brief    H.264 RTP depacketizer declaration (RFC6184)                    *
+*                                                                            *
+*  Details.                                                                  *
+*    Single NAL unit, STAP-A and FU-A packets are reassembled into access    *
+*    units, ended by the marker bit or a change of RTP timestamp.            *
+*                                                                            *
+*----------------------------------------------------------------------------*
+*  Remark   :                                                                *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef __H264_DEPACKETIZER_HEADER_H__
+#define __H264_DEPACKETIZER_HEADER_H__
+
+#include "RtpDepacketizer.h"
+
+class H264Depacketizer : public RtpDepacketizer
+{
+public:
+    explicit H264Depacketizer(Format format = FORMAT_ANNEXB);
+    ~H264Depacketizer();
+
+    bool IsKeyframeStart(const unsigned char* payload, int length) const;
+
+protected:
+    void depacketize(const unsigned char* payload, int length, uint32_t timestamp, bool marker);
+
+    bool isKeyframeNal(unsigned char type) const;
+    bool startsKeyframeNal(unsigned char type) const;
+
+private:
+    static const NalSyntax s_syntax;
+};
+
+#endif
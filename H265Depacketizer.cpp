@@ -0,0 +1,44 @@
+
+#include "H265Depacketizer.h"
+
+/* RFC7798.4.4, ITU-T H.265 Table 7-1 */
+#define H265_NAL_IRAP_FIRST 16
+#define H265_NAL_IRAP_LAST  23
+#define H265_NAL_VPS        32
+#define H265_NAL_SPS        33
+#define H265_NAL_AP         48
+#define H265_NAL_FU         49
+
+#define H265_NAL_IS_IRAP(type)  ((type) >= H265_NAL_IRAP_FIRST && (type) <= H265_NAL_IRAP_LAST)
+
+// two byte NAL unit header with the type in bits 1-6, PACI and reserved types carry nothing we can decode
+const RtpDepacketizer::NalSyntax H265Depacketizer::s_syntax = { 2, 1, 0x3F, 0, H265_NAL_AP, H265_NAL_FU };
+
+H265Depacketizer::H265Depacketizer(Format format)
+    : RtpDepacketizer(format, RTP_DEPACKETIZER_RESERVE, &s_syntax)
+{
+}
+
+H265Depacketizer::~H265Depacketizer()
+{
+}
+
+bool H265Depacketizer::IsKeyframeStart(const unsigned char* payload, int length) const
+{
+    return isNalKeyframeStart(payload, length);
+}
+
+void H265Depacketizer::depacketize(const unsigned char* payload, int length, uint32_t timestamp, bool marker)
+{
+    depacketizeNal(payload, length, timestamp, marker);
+}
+
+bool H265Depacketizer::isKeyframeNal(unsigned char type) const
+{
+    return H265_NAL_IS_IRAP(type);
+}
+
+bool H265Depacketizer::startsKeyframeNal(unsigned char type) const
+{
+    return H265_NAL_IS_IRAP(type) || H265_NAL_VPS == type || H265_NAL_SPS == type;
+}
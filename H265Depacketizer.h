@@ -0,0 +1,40 @@
+
+/*****************************************************************************
+*                                                                            *
+*  @file     H265Depacketizer.h                                              *
+*  @brief    H.265 RTP depacketizer declaration (RFC7798)                    *
+*                                                                            *
+*  Details.                                                                  *
+*    Single NAL unit, AP and FU packets are reassembled into access units,   *
+*    ended by the marker bit or a change of RTP timestamp. Streams with      *
+*    sprop-max-don-diff > 0 (DONL fields) are not supported.                 *
+*                                                                            *
+*----------------------------------------------------------------------------*
+*  Remark   :                                                                *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef __H265_DEPACKETIZER_HEADER_H__
+#define __H265_DEPACKETIZER_HEADER_H__
+
+#include "RtpDepacketizer.h"
+
+class H265Depacketizer : public RtpDepacketizer
+{
+public:
+    explicit H265Depacketizer(Format format = FORMAT_ANNEXB);
+    ~H265Depacketizer();
+
+    bool IsKeyframeStart(const unsigned char* payload, int length) const;
+
+protected:
+    void depacketize(const unsigned char* payload, int length, uint32_t timestamp, bool marker);
+
+    bool isKeyframeNal(unsigned char type) const;
+    bool startsKeyframeNal(unsigned char type) const;
+
+private:
+    static const NalSyntax s_syntax;
+};
+
+#endif
@@ -0,0 +1,305 @@
+
+#include "InterleavedDemuxer.h"
+#include "Logger.h"
+#include "RtspResponse.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <sys/types.h>
+#ifndef _MSC_VER
+#include <sys/socket.h>
+#endif
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MSG_DONTWAIT
+#define RECV_FLAGS  MSG_DONTWAIT
+#else
+#define RECV_FLAGS  0
+#endif
+
+// an RTSP header block larger than this is taken as garbage
+#define RTSP_MAX_HEADER_SIZE    8192
+
+// longer than any method name, GET_PARAMETER is the longest RTSP has
+#define RTSP_MAX_METHOD_SIZE    32
+
+/* Whether what has arrived of 'data' can still be a status line, "RTSP/1.0 200 OK",
+ * or a request line from the server, "SET_PARAMETER rtsp://example.com/ RTSP/1.0" */
+static bool controlStart(const unsigned char* data, size_t size)
+{
+    static const char RTSP_PREFIX[] = "RTSP/";
+    size_t prefix = sizeof(RTSP_PREFIX) - 1;
+    if (memcmp(data, RTSP_PREFIX, (size < prefix) ? size : prefix) == 0)
+    {
+        return true;
+    }
+
+    // method token and a space
+    size_t method = 0;
+    while (method < size && (isupper(data[method]) || '_' == data[method] || '-' == data[method]))
+    {
+        ++method;
+    }
+    if (method == size)
+    {
+        return size <= RTSP_MAX_METHOD_SIZE;
+    }
+    if (0 == method || method > RTSP_MAX_METHOD_SIZE || ' ' != data[method])
+    {
+        return false;
+    }
+
+    // then printable text up to the version at the end of the line
+    std::string_view message((const char*)data, size);
+    size_t eol = message.find('\n');
+    std::string_view line = message.substr(0, eol);
+    if (!line.empty() && '\r' == line.back())
+    {
+        line.remove_suffix(1);
+    }
+    for (char c : line)
+    {
+        if (c < 0x20 || c > 0x7E)
+        {
+            return false;
+        }
+    }
+    return std::string_view::npos == eol || std::string_view::npos != line.find(" RTSP/");
+}
+
+InterleavedDemuxer::InterleavedDemuxer()
+    : _fd(INVALID_SOCKET), _running(false), _closed(false), _poller(), _thread()
+    , _data(), _begin(0), _end(0)
+    , _channel_locker(), _channels(256, nullptr), _touched()
+    , _control_locker(), _control_condition(), _control()
+    , _discarded(0)
+{
+}
+
+InterleavedDemuxer::~InterleavedDemuxer()
+{
+    Stop();
+}
+
+int InterleavedDemuxer::Start(SOCKET fd)
+{
+    if (_running)
+    {
+        return 0;
+    }
+
+    _fd = fd;
+    _closed = false;
+    _data.resize(INTERLEAVED_BUFFER_SIZE);
+    _begin = _end = 0;
+
+    int res = _poller.Create();
+    if (res >= 0 && (res = _poller.Add(fd, this)) >= 0)
+    {
+        _running = true;
+        _thread = std::thread(&InterleavedDemuxer::Run, this);
+    }
+    else
+    {
+        _poller.Destroy();
+    }
+    return res;
+}
+
+void InterleavedDemuxer::Stop()
+{
+    if (_running.exchange(false))
+    {
+        _poller.Wakeup();
+        if (_thread.joinable())
+        {
+            _thread.join();
+        }
+        _poller.Destroy();
+        _fd = INVALID_SOCKET;
+    }
+
+    std::lock_guard<std::mutex> lg(_control_locker);
+    _control.clear();
+}
+
+void InterleavedDemuxer::SetChannel(int channel, Channel* sink)
+{
+    std::lock_guard<std::mutex> lg(_channel_locker);
+    _channels[channel & 0xFF] = sink;
+}
+
+int InterleavedDemuxer::WaitControl(std::string& msg, int timeout_ms)
+{
+    std::unique_lock<std::mutex> ul(_control_locker);
+    _control_condition.wait_for(ul, std::chrono::milliseconds(timeout_ms), [this]() { return !_control.empty() || _closed; });
+    if (_control.empty())
+    {
+        return -1;
+    }
+
+    msg.swap(_control.front());
+    _control.pop_front();
+    return 0;
+}
+
+void InterleavedDemuxer::Run()
+{
+    void* ready[1];
+    while (_running && !_closed)
+    {
+        if (_poller.Wait(ready, 1, 1000) > 0 && _running)
+        {
+            read();
+        }
+    }
+}
+
+void InterleavedDemuxer::read()
+{
+    if (_end == _data.size())
+    {
+        if (_begin > 0)
+        {
+            memmove(_data.data(), _data.data() + _begin, _end - _begin);
+            _end -= _begin;
+            _begin = 0;
+        }
+        else
+        {
+            // nothing in a full buffer could be framed, start over
+            _discarded += _end;
+            _end = 0;
+        }
+    }
+
+    int received = (int)recv(_fd, (char*)_data.data() + _end, (int)(_data.size() - _end), RECV_FLAGS);
+    if (received == 0)
+    {
+        closed();
+        return;
+    }
+    if (received < 0)
+    {
+        if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            LOG_ERROR("interleaved", "read rtsp socket error: %d", errno);
+            closed();
+        }
+        return;
+    }
+    _end += received;
+
+    std::lock_guard<std::mutex> lg(_channel_locker);
+    parse();
+    for (Channel* sink : _touched)
+    {
+        sink->OnInterleavedBatchEnd();
+    }
+    _touched.clear();
+}
+
+void InterleavedDemuxer::parse()
+{
+    while (_begin < _end)
+    {
+        const unsigned char* data = _data.data() + _begin;
+        size_t size = _end - _begin;
+
+        if ('$' == data[0])
+        {
+            /* RFC2326.10.12: '$', channel, 16-bit length, then the RTP or RTCP packet */
+            if (size < 4)
+            {
+                break;
+            }
+            size_t length = ((size_t)data[2] << 8) | data[3];
+            if (size < 4 + length)
+            {
+                break;
+            }
+
+            Channel* sink = _channels[data[1]];
+            if (sink)
+            {
+                sink->OnInterleavedFrame(data[1], data + 4, (int)length);
+                if (std::find(_touched.begin(), _touched.end(), sink) == _touched.end())
+                {
+                    _touched.push_back(sink);
+                }
+            }
+            else
+            {
+                _discarded += 4 + length;
+            }
+            _begin += 4 + length;
+            continue;
+        }
+
+        bool invalid = false;
+        size_t length = parseControl(data, size, invalid);
+        if (length > 0)
+        {
+            std::lock_guard<std::mutex> lg(_control_locker);
+            if (_control.size() >= INTERLEAVED_CONTROL_QUEUE)
+            {
+                _discarded += _control.front().size();
+                _control.pop_front();
+            }
+            _control.push_back(std::string((const char*)data, length));
+            _control_condition.notify_all();
+
+            _begin += length;
+        }
+        else if (invalid)
+        {
+            // lost framing, resynchronise on the next '$' or what may start a status or request line
+            size_t skip = 1;
+            while (skip < size && data[skip] != '$' && !isupper(data[skip]))
+            {
+                ++skip;
+            }
+            _discarded += skip;
+            _begin += skip;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (_begin == _end)
+    {
+        _begin = _end = 0;
+    }
+}
+
+size_t InterleavedDemuxer::parseControl(const unsigned char* data, size_t size, bool& invalid)
+{
+    invalid = !controlStart(data, size);
+    if (invalid)
+    {
+        return 0;
+    }
+
+    // replies and requests from the server are framed alike, the body included
+    std::string_view message((const char*)data, size);
+    size_t length = RtspResponse::MessageLength(message);
+    if (0 == length)
+    {
+        invalid = 0 == RtspResponse::HeaderLength(message) && size > RTSP_MAX_HEADER_SIZE;
+    }
+    return length;
+}
+
+void InterleavedDemuxer::closed()
+{
+    std::lock_guard<std::mutex> lg(_control_locker);
+    _closed = true;
+    _control_condition.notify_all();
+}
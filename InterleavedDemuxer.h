@@ -0,0 +1,114 @@
+
+/*****************************************************************************
+*                                                                            *
+*  @file     InterleavedDemuxer.h                                            *
+*  @brief    RTSP interleaved RTP/RTCP demultiplexer declaration (RFC2326)   *
+*                                                                            *
+*  Details.                                                                  *
+*    Reads the RTSP socket in large chunks and splits the stream into        *
+*    '$' channel frames, handed to the channel registered for them, and      *
+*    RTSP messages, queued for the control path.                             *
+*                                                                            *
+*----------------------------------------------------------------------------*
+*  Remark   :                                                                *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef __INTERLEAVED_DEMUXER_HEADER_H__
+#define __INTERLEAVED_DEMUXER_HEADER_H__
+
+#include "Common.h"
+#include "EventPoller.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// receive buffer, a frame never exceeds 4 + 65535 bytes
+#define INTERLEAVED_BUFFER_SIZE     (256 * 1024)
+
+// RTSP messages received while streaming that nobody has picked up
+#define INTERLEAVED_CONTROL_QUEUE   16
+
+class InterleavedDemuxer
+{
+public:
+    class Channel
+    {
+    public:
+        virtual ~Channel() { }
+
+        /* Called on the demuxer thread for every frame of the channel, data is only valid during the call */
+        virtual void OnInterleavedFrame(int channel, const unsigned char* data, int size) = 0;
+
+        /* Called once after the frames of one socket read were handed out */
+        virtual void OnInterleavedBatchEnd() { }
+    };
+
+public:
+    InterleavedDemuxer();
+    ~InterleavedDemuxer();
+
+    /* Start reading fd on a thread of its own, the caller keeps owning the socket
+    * and may not read it itself until Stop. Writing to it stays allowed */
+    int Start(SOCKET fd);
+    void Stop();
+
+    inline bool Running() const { return _running; }
+
+    /* The peer closed the connection or reading failed */
+    inline bool Closed() const { return _closed; }
+
+    /* Route the frames of 'channel' to 'sink', nullptr removes the route.
+    * Once removed no callback for it is running or will be made */
+    void SetChannel(int channel, Channel* sink);
+
+    /* Next RTSP message (headers and body) received on the socket, a reply or a request from the server.
+    * return:
+    *    0 with a message, -1 on timeout or a closed connection
+    * */
+    int WaitControl(std::string& msg, int timeout_ms);
+
+    /* Bytes skipped while looking for the next frame, and frames nobody was registered for */
+    inline unsigned long long GetDiscardedBytes() const { return _discarded; }
+
+private:
+    void Run();
+
+    void read();
+    void parse();
+    size_t parseControl(const unsigned char* data, size_t size, bool& invalid);
+    void closed();
+
+private:
+    SOCKET _fd;
+    std::atomic<bool> _running;
+    std::atomic<bool> _closed;
+    EventPoller _poller;
+    std::thread _thread;
+
+    // reader side only, _data[_begin, _end) is unparsed
+    std::vector<unsigned char> _data;
+    size_t _begin;
+    size_t _end;
+
+    std::mutex _channel_locker;     // held while dispatching a read, so removing a channel waits for it
+    std::vector<Channel*> _channels;
+    std::vector<Channel*> _touched;     // channels given frames by the current read
+
+    std::mutex _control_locker;
+    std::condition_variable _control_condition;
+    std::deque<std::string> _control;
+
+    std::atomic<unsigned long long> _discarded;
+
+private:
+    InterleavedDemuxer(const InterleavedDemuxer& rhs);
+    InterleavedDemuxer& operator=(const InterleavedDemuxer& rhs);
+};
+
+#endif
@@ -0,0 +1,251 @@
+
+/*****************************************************************************
+*                                                                            *
+*  @file     JitterBuffer.h                                                  *
+*  @brief    RTP sequence number ordered jitter buffer                       *
+*                                                                            *
+*  Details.                                                                  *
+*    Packets are slotted by their 16-bit sequence number and released in     *
+*    order as soon as they are contiguous. A gap is given up as lost once    *
+*    the buffer holds more than 'depth' packets beyond it or the packet      *
+*    after it has waited 'depth' milliseconds, whichever comes first.        *
+*                                                                            *
+*----------------------------------------------------------------------------*
+*  Remark   :                                                                *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef __JITTER_BUFFER_HEADER_H__
+#define __JITTER_BUFFER_HEADER_H__
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include <stdint.h>
+
+// slots of the reorder window, a jump further than this is taken as a stream restart
+#define JITTER_BUFFER_SLOTS     1024
+
+struct JitterStatistics
+{
+    unsigned long long lost = 0;        // sequence numbers given up on
+    unsigned long long late = 0;        // arrived after their slot was released or given up
+    unsigned long long duplicated = 0;
+    unsigned long long reordered = 0;   // arrived after a higher sequence number but still in time
+    unsigned long long resyncs = 0;     // sequence jumps beyond the window
+};
+
+template <typename T>
+class JitterBuffer
+{
+public:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+
+public:
+    JitterBuffer()
+        : _slots(JITTER_BUFFER_SLOTS), _depth_packets(0), _depth_ms(0)
+        , _started(false), _expected(0), _highest(0), _held(0)
+        , _lost(0), _late(0), _duplicated(0), _reordered(0), _resyncs(0)
+    {
+    }
+
+    /* depth_packets / depth_ms: 0 disables that limit, both 0 disables the buffer */
+    void SetDepth(int depth_packets, int depth_ms)
+    {
+        _depth_packets = (depth_packets < JITTER_BUFFER_SLOTS - 1) ? depth_packets : JITTER_BUFFER_SLOTS - 1;
+        _depth_ms = depth_ms;
+    }
+
+    inline bool Enabled() const { return _depth_packets > 0 || _depth_ms > 0; }
+
+    /* Slot an item in, then hand every item that is due to release(item) in sequence order
+    * and every gap given up to lost(first_sequence, count).
+    * return:
+    *    false if the item was late or a duplicate, it is not kept and still belongs to the caller
+    * */
+    template <typename Release, typename Lost>
+    bool Insert(uint16_t sequence, const T& item, const TimePoint& now, Release release, Lost lost)
+    {
+        if (!_started)
+        {
+            _started = true;
+            _expected = sequence;
+            _highest = sequence;
+        }
+
+        int16_t diff = (int16_t)(uint16_t)(sequence - _expected);
+        if (diff < 0 && diff > -JITTER_BUFFER_SLOTS)
+        {
+            ++_late;
+            return false;
+        }
+
+        if (diff < 0 || diff >= JITTER_BUFFER_SLOTS)
+        {
+            // restart: release whatever is held and start over at the new position
+            ++_resyncs;
+            Flush(release);
+            _expected = sequence;
+            _highest = sequence;
+        }
+
+        Slot& slot = _slots[sequence % JITTER_BUFFER_SLOTS];
+        if (slot.used)
+        {
+            ++_duplicated;
+            return false;
+        }
+
+        if ((int16_t)(uint16_t)(sequence - _highest) > 0)
+        {
+            _highest = sequence;
+        }
+        else if (sequence != _expected || _held > 0)
+        {
+            ++_reordered;
+        }
+
+        slot.used = true;
+        slot.item = item;
+        slot.arrival = now;
+        ++_held;
+
+        Expire(now, release, lost);
+        return true;
+    }
+
+    /* Release what is due at 'now' without a new arrival */
+    template <typename Release, typename Lost>
+    void Expire(const TimePoint& now, Release release, Lost lost)
+    {
+        while (_held > 0)
+        {
+            drain(release);
+            if (_held == 0)
+            {
+                break;
+            }
+
+            // _expected is missing, give it up if the packets behind it can not wait any longer
+            uint16_t next = _expected;
+            while (!_slots[next % JITTER_BUFFER_SLOTS].used)
+            {
+                ++next;
+            }
+
+            int span = (int)(uint16_t)(_highest - _expected) + 1;
+            bool overflow = _depth_packets > 0 && span > _depth_packets;
+            bool timeout = _depth_ms > 0 && now - _slots[next % JITTER_BUFFER_SLOTS].arrival >= std::chrono::milliseconds(_depth_ms);
+            if (!overflow && !timeout)
+            {
+                break;
+            }
+
+            int missing = (int)(uint16_t)(next - _expected);
+            _lost += missing;
+            lost(_expected, missing);
+            _expected = next;
+        }
+    }
+
+    /* Release every held item in order regardless of gaps */
+    template <typename Release>
+    void Flush(Release release)
+    {
+        while (_held > 0)
+        {
+            Slot& slot = _slots[_expected % JITTER_BUFFER_SLOTS];
+            if (slot.used)
+            {
+                slot.used = false;
+                --_held;
+                release(slot.item);
+            }
+            ++_expected;
+        }
+    }
+
+    /* Release every held item and forget the stream position, the next Insert starts over */
+    template <typename Release>
+    void Reset(Release release)
+    {
+        Flush(release);
+        _started = false;
+        _expected = 0;
+        _highest = 0;
+    }
+
+    /* Milliseconds until Expire has something to do, -1 if nothing is waiting on a gap */
+    int GetTimeout(const TimePoint& now) const
+    {
+        if (_held == 0 || _depth_ms <= 0)
+        {
+            return -1;
+        }
+
+        uint16_t next = _expected;
+        while (!_slots[next % JITTER_BUFFER_SLOTS].used)
+        {
+            ++next;
+        }
+        std::chrono::milliseconds waited = std::chrono::duration_cast<std::chrono::milliseconds>(now - _slots[next % JITTER_BUFFER_SLOTS].arrival);
+        return (waited.count() >= _depth_ms) ? 0 : (int)(_depth_ms - waited.count());
+    }
+
+    /* safe from any thread */
+    JitterStatistics GetStatistics() const
+    {
+        JitterStatistics statistics;
+        statistics.lost = _lost;
+        statistics.late = _late;
+        statistics.duplicated = _duplicated;
+        statistics.reordered = _reordered;
+        statistics.resyncs = _resyncs;
+        return statistics;
+    }
+
+private:
+    template <typename Release>
+    void drain(Release release)
+    {
+        Slot* slot = nullptr;
+        while (_held > 0 && (slot = &_slots[_expected % JITTER_BUFFER_SLOTS])->used)
+        {
+            slot->used = false;
+            --_held;
+            ++_expected;
+            release(slot->item);
+        }
+    }
+
+private:
+    struct Slot
+    {
+        bool used = false;
+        T item;
+        TimePoint arrival;
+    };
+
+    std::vector<Slot> _slots;
+    int _depth_packets;
+    int _depth_ms;
+
+    bool _started;
+    uint16_t _expected;     // next sequence number to release
+    uint16_t _highest;
+    int _held;
+
+private:
+    std::atomic<unsigned long long> _lost;
+    std::atomic<unsigned long long> _late;
+    std::atomic<unsigned long long> _duplicated;
+    std::atomic<unsigned long long> _reordered;
+    std::atomic<unsigned long long> _resyncs;
+
+private:
+    JitterBuffer(const JitterBuffer& rhs);
+    JitterBuffer& operator=(const JitterBuffer& rhs);
+};
+
+#endif
@@ -0,0 +1,229 @@
+
+#include "Logger.h"
+#include "EventNotifier.h"
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// records the ring holds, power of two
+#define LOG_RING_SIZE       1024
+#define LOG_TAG_SIZE        32
+#define LOG_MESSAGE_SIZE    256
+
+std::atomic<int> Logger::_level(LOG_LEVEL_TRACE);
+
+namespace
+{
+    struct Record
+    {
+        std::atomic<size_t> sequence;
+        int level;
+        std::chrono::system_clock::time_point time;
+        char tag[LOG_TAG_SIZE];
+        char message[LOG_MESSAGE_SIZE];
+    };
+
+    /* Bounded multi-producer single-consumer ring: a slot's sequence tells whether it is free
+    * for the producer claiming position 'pos' (== pos) or ready for the consumer (== pos + 1) */
+    class LogWriter
+    {
+    public:
+        LogWriter()
+            : _records(new Record[LOG_RING_SIZE]), _write(0), _read(0), _dropped(0)
+            , _sink(nullptr), _userdata(nullptr), _stopped(false)
+        {
+            for (size_t i = 0; i < LOG_RING_SIZE; ++i)
+            {
+                _records[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        ~LogWriter()
+        {
+            _stopped = true;
+            _notifier.Notify();
+            if (_thread.joinable())
+            {
+                _thread.join();
+            }
+            delete[] _records;
+        }
+
+        void Write(int level, const char* tag, const char* format, va_list args)
+        {
+            if (_stopped)
+            {
+                return;
+            }
+            std::call_once(_started, [this]() { _thread = std::thread(&LogWriter::Run, this); });
+
+            size_t pos = _write.load(std::memory_order_relaxed);
+            Record* record = nullptr;
+            while (true)
+            {
+                record = &_records[pos & (LOG_RING_SIZE - 1)];
+                size_t sequence = record->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+                if (0 == diff)
+                {
+                    if (_write.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    ++_dropped;
+                    return;
+                }
+                else
+                {
+                    pos = _write.load(std::memory_order_relaxed);
+                }
+            }
+
+            record->level = level;
+            record->time = std::chrono::system_clock::now();
+            snprintf(record->tag, sizeof(record->tag), "%s", tag ? tag : "");
+            vsnprintf(record->message, sizeof(record->message), format, args);
+            record->sequence.store(pos + 1, std::memory_order_release);
+
+            _notifier.Notify();
+        }
+
+        void SetSink(Logger::Sink sink, void* userdata)
+        {
+            std::lock_guard<std::mutex> lg(_sink_locker);
+            _sink = sink;
+            _userdata = userdata;
+        }
+
+        void Flush()
+        {
+            size_t target = _write.load(std::memory_order_acquire);
+            std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+            while ((intptr_t)(_read.load(std::memory_order_acquire) - target) < 0 && std::chrono::steady_clock::now() < deadline)
+            {
+                _notifier.Notify();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        inline unsigned long long GetDroppedCount() const { return _dropped; }
+
+    private:
+        bool ready() const
+        {
+            size_t pos = _read.load(std::memory_order_relaxed);
+            return _records[pos & (LOG_RING_SIZE - 1)].sequence.load(std::memory_order_acquire) == pos + 1;
+        }
+
+        void Run()
+        {
+            while (true)
+            {
+                _notifier.WaitFor(std::chrono::milliseconds(100), [this]() { return ready() || _stopped; });
+
+                bool written = false;
+                while (ready())
+                {
+                    size_t pos = _read.load(std::memory_order_relaxed);
+                    Record& record = _records[pos & (LOG_RING_SIZE - 1)];
+                    emit(record);
+                    record.sequence.store(pos + LOG_RING_SIZE, std::memory_order_release);
+                    _read.store(pos + 1, std::memory_order_release);
+                    written = true;
+                }
+                if (written)
+                {
+                    fflush(stderr);
+                }
+
+                if (_stopped)
+                {
+                    break;
+                }
+            }
+        }
+
+        void emit(const Record& record)
+        {
+            static const char* const LEVEL_NAMES[] = { "TRACE", "DEBUG", "INFO", "WARN", "ERROR" };
+            const char* level = (record.level >= LOG_LEVEL_TRACE && record.level < LOG_LEVEL_NONE) ? LEVEL_NAMES[record.level] : "?";
+
+            std::lock_guard<std::mutex> lg(_sink_locker);
+            if (_sink)
+            {
+                _sink(_userdata, record.level, record.tag, record.message);
+                return;
+            }
+
+            time_t seconds = std::chrono::system_clock::to_time_t(record.time);
+            int milliseconds = (int)(std::chrono::duration_cast<std::chrono::milliseconds>(record.time.time_since_epoch()).count() % 1000);
+            struct tm local;
+#ifdef _MSC_VER
+            localtime_s(&local, &seconds);
+#else
+            localtime_r(&seconds, &local);
+#endif
+            fprintf(stderr, "%02d:%02d:%02d.%03d %-5s [%s] %s\n",
+                local.tm_hour, local.tm_min, local.tm_sec, milliseconds, level, record.tag, record.message);
+        }
+
+    private:
+        Record* _records;
+        std::atomic<size_t> _write;
+        std::atomic<size_t> _read;
+        std::atomic<unsigned long long> _dropped;
+
+        std::mutex _sink_locker;    // only taken by the logging thread and SetSink
+        Logger::Sink _sink;
+        void* _userdata;
+
+        EventNotifier _notifier;
+        std::once_flag _started;
+        std::thread _thread;
+        std::atomic<bool> _stopped;
+    };
+
+    LogWriter& writer()
+    {
+        static LogWriter instance;
+        return instance;
+    }
+}
+
+void Logger::SetLevel(int level)
+{
+    _level.store(level, std::memory_order_relaxed);
+}
+
+void Logger::SetSink(Sink sink, void* userdata)
+{
+    writer().SetSink(sink, userdata);
+}
+
+void Logger::Write(int level, const char* tag, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    writer().Write(level, tag, format, args);
+    va_end(args);
+}
+
+void Logger::Flush()
+{
+    writer().Flush();
+}
+
+unsigned long long Logger::GetDroppedCount()
+{
+    return writer().GetDroppedCount();
+}
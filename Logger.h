@@ -0,0 +1,80 @@
+
+/*****************************************************************************
+*                                                                            *
+*  @file     Logger.h                                                        *
+*  @brief    Leveled, tagged asynchronous logging                            *
+*                                                                            *
+*  Details.                                                                  *
+*    Levels below RTSP_LOG_LEVEL compile to nothing, their arguments are     *
+*    never evaluated. Records are formatted by the caller into a lock-free   *
+*    ring and written out by a background thread, so no receive thread       *
+*    ever blocks on stderr. Records are dropped and counted when it is full. *
+*                                                                            *
+*----------------------------------------------------------------------------*
+*  Remark   :                                                                *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef __LOGGER_HEADER_H__
+#define __LOGGER_HEADER_H__
+
+#include <atomic>
+
+#define LOG_LEVEL_TRACE     0
+#define LOG_LEVEL_DEBUG     1
+#define LOG_LEVEL_INFO      2
+#define LOG_LEVEL_WARN      3
+#define LOG_LEVEL_ERROR     4
+#define LOG_LEVEL_NONE      5
+
+// lowest level compiled in, e.g. -DRTSP_LOG_LEVEL=0 for per-packet tracing
+#ifndef RTSP_LOG_LEVEL
+#define RTSP_LOG_LEVEL      LOG_LEVEL_INFO
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define LOG_PRINTF_FORMAT(fmt, args) __attribute__((format(printf, fmt, args)))
+#else
+#define LOG_PRINTF_FORMAT(fmt, args)
+#endif
+
+#define RTSP_LOG(level, tag, ...) \
+    do { \
+        if ((level) >= RTSP_LOG_LEVEL && Logger::Enabled(level)) \
+            Logger::Write((level), (tag), __VA_ARGS__); \
+    } while (0)
+
+#define LOG_TRACE(tag, ...) RTSP_LOG(LOG_LEVEL_TRACE, tag, __VA_ARGS__)
+#define LOG_DEBUG(tag, ...) RTSP_LOG(LOG_LEVEL_DEBUG, tag, __VA_ARGS__)
+#define LOG_INFO(tag, ...)  RTSP_LOG(LOG_LEVEL_INFO, tag, __VA_ARGS__)
+#define LOG_WARN(tag, ...)  RTSP_LOG(LOG_LEVEL_WARN, tag, __VA_ARGS__)
+#define LOG_ERROR(tag, ...) RTSP_LOG(LOG_LEVEL_ERROR, tag, __VA_ARGS__)
+
+class Logger
+{
+public:
+    /* Called on the logging thread for every record, message has no trailing newline */
+    typedef void(*Sink)(void* userdata, int level, const char* tag, const char* message);
+
+public:
+    /* Runtime threshold on top of RTSP_LOG_LEVEL, LOG_LEVEL_NONE silences everything */
+    static void SetLevel(int level);
+    static inline bool Enabled(int level) { return level >= _level.load(std::memory_order_relaxed); }
+
+    /* nullptr restores the default sink writing to stderr */
+    static void SetSink(Sink sink, void* userdata);
+
+    /* Use the LOG_* macros rather than calling this, safe from any thread */
+    static void Write(int level, const char* tag, const char* format, ...) LOG_PRINTF_FORMAT(3, 4);
+
+    /* Wait until everything written so far reached the sink */
+    static void Flush();
+
+    /* Records lost to a full ring */
+    static unsigned long long GetDroppedCount();
+
+private:
+    static std::atomic<int> _level;
+};
+
+#endif
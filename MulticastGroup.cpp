@@ -0,0 +1,391 @@
+
+#include "MulticastGroup.h"
+#include "Logger.h"
+
+#include <map>
+
+#include <sys/types.h>
+#ifdef _MSC_VER
+#include <ws2tcpip.h>
+#include <iphlpapi.h>
+#pragma comment(lib, "iphlpapi.lib")
+#else
+#include <sys/socket.h>
+#include <net/if.h>
+#include <netdb.h>
+#include <unistd.h>
+#define closesocket close
+#endif
+#include <string.h>
+#include <errno.h>
+
+#define Close_Socket(fd) if(fd != INVALID_SOCKET) { closesocket(fd); fd = INVALID_SOCKET; }
+
+// idle subscribers still get an OnInterleavedBatchEnd this often, for their jitter buffer timeouts
+#define MULTICAST_TICK_MS   1000
+
+static std::mutex s_locker;
+static std::map<std::string, MulticastGroup*> s_groups;
+
+static int resolveAddress(const std::string& address, struct sockaddr_storage& addr)
+{
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    struct addrinfo* result = nullptr;
+    if (address.empty() || getaddrinfo(address.c_str(), nullptr, &hints, &result) != 0 || !result)
+    {
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    memcpy(&addr, result->ai_addr, result->ai_addrlen);
+    freeaddrinfo(result);
+    return 0;
+}
+
+static void setAddressPort(struct sockaddr_storage& addr, unsigned short port)
+{
+    if (AF_INET6 == addr.ss_family)
+    {
+        ((struct sockaddr_in6*)&addr)->sin6_port = htons(port);
+    }
+    else
+    {
+        ((struct sockaddr_in*)&addr)->sin_port = htons(port);
+    }
+}
+
+static SOCKET joinGroup(const struct sockaddr_storage& group, const struct sockaddr_storage* source, unsigned int interface_index, unsigned short port)
+{
+    SOCKET fd = socket(group.ss_family, SOCK_DGRAM, 0);
+    if (fd == INVALID_SOCKET)
+    {
+        return INVALID_SOCKET;
+    }
+
+    // other processes on the host may watch the same group
+    int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (const char*)&enable, sizeof(enable));
+
+    // bound to the group address, the socket only gets the datagrams sent to it
+    struct sockaddr_storage local = group;
+#ifdef _MSC_VER
+    // Windows can not bind to a group address, it filters by the joins of the socket instead
+    if (AF_INET6 == local.ss_family)
+    {
+        ((struct sockaddr_in6*)&local)->sin6_addr = in6addr_any;
+    }
+    else
+    {
+        ((struct sockaddr_in*)&local)->sin_addr.s_addr = htonl(INADDR_ANY);
+    }
+#endif
+    setAddressPort(local, port);
+
+    socklen_t length = (AF_INET6 == local.ss_family) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+    if (bind(fd, (struct sockaddr *)&local, length) < 0)
+    {
+        Close_Socket(fd);
+        return INVALID_SOCKET;
+    }
+
+    int level = (AF_INET6 == group.ss_family) ? IPPROTO_IPV6 : IPPROTO_IP;
+
+    // Linux hands a socket the traffic of every group joined on the host by default, sources included
+    int disable = 0;
+#ifdef IP_MULTICAST_ALL
+    if (IPPROTO_IP == level)
+    {
+        setsockopt(fd, level, IP_MULTICAST_ALL, &disable, sizeof(disable));
+    }
+#endif
+#ifdef IPV6_MULTICAST_ALL
+    if (IPPROTO_IPV6 == level)
+    {
+        setsockopt(fd, level, IPV6_MULTICAST_ALL, &disable, sizeof(disable));
+    }
+#endif
+
+    int res = 0;
+    if (source)
+    {
+        struct group_source_req request;
+        memset(&request, 0, sizeof(request));
+        request.gsr_interface = interface_index;
+        memcpy(&request.gsr_group, &group, sizeof(group));
+        memcpy(&request.gsr_source, source, sizeof(*source));
+        res = setsockopt(fd, level, MCAST_JOIN_SOURCE_GROUP, (const char*)&request, sizeof(request));
+    }
+    else
+    {
+        struct group_req request;
+        memset(&request, 0, sizeof(request));
+        request.gr_interface = interface_index;
+        memcpy(&request.gr_group, &group, sizeof(group));
+        res = setsockopt(fd, level, MCAST_JOIN_GROUP, (const char*)&request, sizeof(request));
+    }
+
+    if (res < 0)
+    {
+        Close_Socket(fd);
+        return INVALID_SOCKET;
+    }
+    return fd;
+}
+
+MulticastGroup* MulticastGroup::Join(const MulticastEndpoint& endpoint)
+{
+    std::string key = endpoint.group + "|" + std::to_string(endpoint.rtp_port) + "|" + endpoint.source + "|" + endpoint.interface;
+
+    std::lock_guard<std::mutex> lg(s_locker);
+    std::map<std::string, MulticastGroup*>::iterator it = s_groups.find(key);
+    if (it != s_groups.end())
+    {
+        ++it->second->_references;
+        return it->second;
+    }
+
+    MulticastGroup* group = new MulticastGroup(key);
+    if (group->open(endpoint) < 0)
+    {
+        LOG_ERROR("multicast", "join %s:%u source '%s' error: %d", endpoint.group.c_str(), endpoint.rtp_port, endpoint.source.c_str(), errno);
+        delete group;
+        return nullptr;
+    }
+
+    group->_references = 1;
+    s_groups[key] = group;
+    return group;
+}
+
+void MulticastGroup::Leave(MulticastGroup* group)
+{
+    if (!group)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lg(s_locker);
+        if (--group->_references > 0)
+        {
+            return;
+        }
+        s_groups.erase(group->_key);
+    }
+    delete group;
+}
+
+bool MulticastGroup::IsMulticast(const std::string& address)
+{
+    struct in_addr addr4;
+    struct in6_addr addr6;
+    if (inet_pton(AF_INET, address.c_str(), &addr4) == 1)
+    {
+        return (ntohl(addr4.s_addr) >> 28) == 0xE;
+    }
+    if (inet_pton(AF_INET6, address.c_str(), &addr6) == 1)
+    {
+        return addr6.s6_addr[0] == 0xFF;
+    }
+    return false;
+}
+
+bool MulticastGroup::IsSourceSpecific(const std::string& address)
+{
+    struct in_addr addr4;
+    struct in6_addr addr6;
+    if (inet_pton(AF_INET, address.c_str(), &addr4) == 1)
+    {
+        return (ntohl(addr4.s_addr) >> 24) == 232;
+    }
+    if (inet_pton(AF_INET6, address.c_str(), &addr6) == 1)
+    {
+        return addr6.s6_addr[0] == 0xFF && (addr6.s6_addr[1] & 0xF0) == 0x30;
+    }
+    return false;
+}
+
+MulticastGroup::MulticastGroup(const std::string& key)
+    : _key(key), _references(0)
+    , _receiver(), _poller(), _thread(), _running(false)
+    , _rtp(), _rtcp(), _dispatching()
+    , _locker(), _returned(), _subscribers(), _calling(nullptr)
+    , _receive_buffer(0), _granted_buffer(0)
+{
+}
+
+MulticastGroup::~MulticastGroup()
+{
+    close();
+}
+
+void MulticastGroup::Subscribe(InterleavedDemuxer::Channel* subscriber, int rtp_channel, int rtcp_channel)
+{
+    Subscriber entry;
+    entry.channel = subscriber;
+    entry.rtp_channel = rtp_channel;
+    entry.rtcp_channel = rtcp_channel;
+
+    std::lock_guard<std::mutex> lg(_locker);
+    _subscribers.push_back(entry);
+}
+
+void MulticastGroup::Unsubscribe(InterleavedDemuxer::Channel* subscriber)
+{
+    std::unique_lock<std::mutex> lock(_locker);
+    for (std::vector<Subscriber>::iterator it = _subscribers.begin(); it != _subscribers.end(); ++it)
+    {
+        if (it->channel == subscriber)
+        {
+            _subscribers.erase(it);
+            break;
+        }
+    }
+    _returned.wait(lock, [this, subscriber]() { return _calling != subscriber; });
+}
+
+int MulticastGroup::ReserveReceiveBuffer(int bytes)
+{
+    std::lock_guard<std::mutex> lg(_locker);
+    if (bytes > _receive_buffer)
+    {
+        int granted = UdpReceiver::SetReceiveBuffer(_receiver.GetRTPSocket(), bytes);
+        if (granted < 0)
+        {
+            return -1;
+        }
+        _receive_buffer = bytes;
+        _granted_buffer = granted;
+    }
+    return _granted_buffer;
+}
+
+int MulticastGroup::open(const MulticastEndpoint& endpoint)
+{
+    struct sockaddr_storage group, source;
+    if (resolveAddress(endpoint.group, group) < 0)
+    {
+        return -1;
+    }
+    if (!endpoint.source.empty() && (resolveAddress(endpoint.source, source) < 0 || source.ss_family != group.ss_family))
+    {
+        return -1;
+    }
+
+    unsigned int interface_index = 0;
+    if (!endpoint.interface.empty() && (interface_index = if_nametoindex(endpoint.interface.c_str())) == 0)
+    {
+        return -1;
+    }
+
+    const struct sockaddr_storage* filter = endpoint.source.empty() ? nullptr : &source;
+    SOCKET rtp_socket = joinGroup(group, filter, interface_index, endpoint.rtp_port);
+    SOCKET rtcp_socket = joinGroup(group, filter, interface_index, endpoint.rtcp_port);
+
+    int res = _receiver.Create(rtp_socket, rtcp_socket);
+    if (res >= 0 && (res = _poller.Create()) >= 0 &&
+        (res = _poller.Add(_receiver.GetRTPSocket(), this)) >= 0 &&
+        (res = _poller.Add(_receiver.GetRTCPSocket(), this)) >= 0)
+    {
+        _running = true;
+        _thread = std::thread(&MulticastGroup::Run, this);
+    }
+    else
+    {
+        close();
+    }
+    return res;
+}
+
+void MulticastGroup::close()
+{
+    if (_running.exchange(false))
+    {
+        _poller.Wakeup();
+        if (_thread.joinable())
+        {
+            _thread.join();
+        }
+    }
+    _poller.Destroy();
+    _receiver.Destroy();
+}
+
+void MulticastGroup::Run()
+{
+    void* ready[2];
+    while (_running)
+    {
+        int count = _poller.Wait(ready, 2, MULTICAST_TICK_MS);
+        if (!_running)
+        {
+            break;
+        }
+        if (count > 0 && _receiver.Receive(_rtp, &_rtcp) < 0)
+        {
+            LOG_ERROR("multicast", "receive error: %d", errno);
+        }
+        dispatch();
+    }
+}
+
+void MulticastGroup::dispatch()
+{
+    {
+        std::lock_guard<std::mutex> lg(_locker);
+        _dispatching = _subscribers;
+    }
+
+    for (const Subscriber& subscriber : _dispatching)
+    {
+        {
+            // skip the ones unsubscribed since the snapshot, the others are called without the lock
+            std::lock_guard<std::mutex> lg(_locker);
+            bool subscribed = false;
+            for (const Subscriber& entry : _subscribers)
+            {
+                subscribed = subscribed || entry.channel == subscriber.channel;
+            }
+            if (!subscribed)
+            {
+                continue;
+            }
+            _calling = subscriber.channel;
+        }
+
+        // each subscriber copies what it keeps, the datagrams go back to the pool right after
+        if (subscriber.rtcp_channel >= 0)
+        {
+            for (UdpReceiver::Datagram* datagram : _rtcp)
+            {
+                subscriber.channel->OnInterleavedFrame(subscriber.rtcp_channel, datagram->data, datagram->size);
+            }
+        }
+        for (UdpReceiver::Datagram* datagram : _rtp)
+        {
+            subscriber.channel->OnInterleavedFrame(subscriber.rtp_channel, datagram->data, datagram->size);
+        }
+        subscriber.channel->OnInterleavedBatchEnd();
+
+        {
+            std::lock_guard<std::mutex> lg(_locker);
+            _calling = nullptr;
+        }
+        _returned.notify_all();
+    }
+
+    for (UdpReceiver::Datagram* datagram : _rtp)
+    {
+        _receiver.Release(datagram);
+    }
+    for (UdpReceiver::Datagram* datagram : _rtcp)
+    {
+        _receiver.Release(datagram);
+    }
+    _rtp.clear();
+    _rtcp.clear();
+}
@@ -0,0 +1,111 @@
+
+/*****************************************************************************
+*                                                                            *
+*  @file     MulticastGroup.h                                                *
+*  @brief    Shared multicast RTP/RTCP receive sockets declaration           *
+*                                                                            *
+*  Details.                                                                  *
+*    Joins a group any-source or source-specific (IGMPv3/MLDv2) once per     *
+*    process. Every RtpClient watching the same group shares its socket      *
+*    pair and the thread reading it, which hands each of them the packets.   *
+*                                                                            *
+*----------------------------------------------------------------------------*
+*  Remark   :                                                                *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef __MULTICAST_GROUP_HEADER_H__
+#define __MULTICAST_GROUP_HEADER_H__
+
+#include "Common.h"
+#include "EventPoller.h"
+#include "UdpReceiver.h"
+#include "InterleavedDemuxer.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class MulticastGroup
+{
+public:
+    /* The group of 'endpoint', joined on the first call and shared by the later ones.
+    * return:
+    *    nullptr if the group can not be joined, otherwise hand it back with Leave
+    * */
+    static MulticastGroup* Join(const MulticastEndpoint& endpoint);
+
+    /* The last Leave of a group stops its thread and closes the sockets, which leaves the group.
+    * Must not be called from inside a callback of the group */
+    static void Leave(MulticastGroup* group);
+
+    static bool IsMulticast(const std::string& address);
+
+    /* 232.0.0.0/8 and ff3x::/32, where receivers have to name the source they join */
+    static bool IsSourceSpecific(const std::string& address);
+
+    /* Hand the packets of the group to 'subscriber' on the group thread, tagged with the given channels.
+    * OnInterleavedBatchEnd follows every read, and about once a second while the group is idle */
+    void Subscribe(InterleavedDemuxer::Channel* subscriber, int rtp_channel, int rtcp_channel);
+
+    /* Once this returns no callback for 'subscriber' is running or will be made.
+    * Must not be called from inside a callback of the group */
+    void Unsubscribe(InterleavedDemuxer::Channel* subscriber);
+
+    /* Grow the kernel receive queue of the RTP socket to at least 'bytes', it never shrinks while shared.
+    * return:
+    *    the size the kernel granted, -1 on error
+    * */
+    int ReserveReceiveBuffer(int bytes);
+
+    /* Datagrams the kernel dropped on the shared sockets, see UdpReceiver::GetOverflowCount */
+    inline unsigned long long GetOverflowCount() const { return _receiver.GetOverflowCount(); }
+
+private:
+    struct Subscriber
+    {
+        InterleavedDemuxer::Channel* channel;
+        int rtp_channel;
+        int rtcp_channel;
+    };
+
+    explicit MulticastGroup(const std::string& key);
+    ~MulticastGroup();
+
+    int open(const MulticastEndpoint& endpoint);
+    void close();
+
+    void Run();
+    void dispatch();
+
+private:
+    std::string _key;
+    int _references;    // guarded by the registry lock
+
+    UdpReceiver _receiver;
+    EventPoller _poller;
+    std::thread _thread;
+    std::atomic<bool> _running;
+
+    // group thread only
+    std::vector<UdpReceiver::Datagram*> _rtp;
+    std::vector<UdpReceiver::Datagram*> _rtcp;
+    std::vector<Subscriber> _dispatching;
+
+    // never held across a callback, a slow subscriber does not block Subscribe or the other Unsubscribes
+    std::mutex _locker;
+    std::condition_variable _returned;
+    std::vector<Subscriber> _subscribers;
+    InterleavedDemuxer::Channel* _calling;     // the subscriber in a callback, Unsubscribe waits for it
+    int _receive_buffer;
+    int _granted_buffer;
+
+private:
+    MulticastGroup(const MulticastGroup& rhs);
+    MulticastGroup& operator=(const MulticastGroup& rhs);
+};
+
+#endif
@@ -1,224 +1,788 @@
-
-#include "RtpClient.h"
-
-#include "ErrorCode.h"
-
-#ifdef _MSC_VER
-#ifdef RTP_SUPPORT_THREAD
-#pragma comment(lib, "jthread.lib")
-#endif
-#pragma comment(lib, "jrtplib.lib")
-#endif
-
-RtpClient::RtpClient()
-    : _session_param()
-    , _udp_v4(), _udp_session()
-    , _tcp_v4(nullptr), _tcp_session()
-    , _running(false), _thread(), _locker(), _condition(), _payloads()
-{
-}
-
-RtpClient::~RtpClient()
-{
-    if (_thread.joinable())
-    {
-        _thread.join();
-    }
-}
-
-int RtpClient::Create(SOCKET fd, int time_rate)
-{
-    std::lock_guard<std::mutex> lg(_locker);
-    if (_running)
-    {
-        return 0;
-    }
-
-    if (!_tcp_v4)
-    {
-        _tcp_v4 = new RTSPTCPTransmitter();
-    }
-
-    bool threadsafe = false;
-#ifdef RTP_SUPPORT_THREAD
-    threadsafe = true;
-#endif // RTP_SUPPORT_THREAD
-
-    _session_param.SetOwnTimestampUnit(1.0 / (double)time_rate);
-    _session_param.SetAcceptOwnPackets(true);
-    _session_param.SetProbationType(RTPSources::NoProbation);
-    _session_param.SetMaximumPacketSize(1500);
-
-    int res = 0;
-    if ((res = _tcp_v4->Init(threadsafe)) >= 0 &&
-        (res = _tcp_v4->Create(65535, nullptr)) >= 0 &&
-        (res = _udp_session.Create(_session_param, _tcp_v4)) >= 0)
-    {
-        _udp_session.AddDestination(RTPTCPAddress(fd));
-    }
-
+
+#include "RtpClient.h"
+
+#include "ErrorCode.h"
+
+#include <errno.h>
+
+#ifdef _MSC_VER
+#ifdef RTP_SUPPORT_THREAD
+#pragma comment(lib, "jthread.lib")
+#endif
+#pragma comment(lib, "jrtplib.lib")
+#endif
+
+// upper bound of an idle wait, Run() still has to call Poll() for jrtplib to keep its RTCP schedule
+#define RTP_POLL_TIMEOUT_MS     1000
+
+// packets the receive queue holds by default, see SetQueueCapacity
+#define RTP_QUEUE_CAPACITY      4096
+
+// OVERFLOW_DROP_OLDEST: evictions tried before the arriving packet is dropped after all,
+// the consumer holds a slot only for the copy of one packet
+#define RTP_QUEUE_EVICT_TRIES   4
+
+// OVERFLOW_BLOCK: upper bound of one wait for room, Destroy wakes the receive thread anyway
+#define RTP_QUEUE_BLOCK_WAIT_MS 100
+
+// kernel receive queue of the RTP socket by default, a few keyframes of a high bitrate stream
+#define RTP_RECEIVE_BUFFER      (2 * 1024 * 1024)
+
+static std::atomic<int> s_default_receive_buffer(RTP_RECEIVE_BUFFER);
+
+RtpClient::RtpClient()
+    : _log_tag("rtp"), _memory_pool()
+    , _session_param()
+    , _udp_v4(), _udp_session(nullptr, &_memory_pool)
+    , _tcp_v4(nullptr), _tcp_session(_log_tag)
+    , _backend(RECV_JRTPLIB), _native_udp(false), _udp_receiver(), _datagrams(), _rtcp_datagrams()
+    , _demuxer(nullptr), _multicast(nullptr), _rtp_channel(-1), _rtcp_channel(-1)
+    , _running(false), _reactor(nullptr), _poller(), _thread(), _locker(), _notifier(), _payloads(RTP_QUEUE_CAPACITY)
+    , _max_packets(RTP_QUEUE_CAPACITY), _max_bytes(0), _queued_bytes(0), _policy(OVERFLOW_DROP_NEWEST), _space()
+    , _current(), _current_valid(false), _waiting_keyframe(false)
+    , _dropped(0), _dropped_newest(0), _dropped_oldest(0), _dropped_until_keyframe(0), _blocked(0)
+    , _receive_buffer(0), _granted_buffer(0), _drop_locker(), _drop_sockets(), _drop_socket_count(0)
+    , _depacketizer(nullptr), _sink(nullptr), _sink_batch(), _sink_views(), _sink_frames()
+#ifdef RTSP_COROUTINE
+    , _async_waiter(nullptr), _async_waking(0)
+#endif
+    , _statistics(), _clock()
+    , _jitter(), _loss_callback(nullptr), _loss_userdata(nullptr)
+{
+}
+
+RtpClient::~RtpClient()
+{
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+
+    // queued packets belong to _memory_pool, hand them back while it is still alive
+    _jitter.Flush([this](const Payload& payload) { releasePayload(payload); });
+    ClearData();
+
+    delete _depacketizer;
+}
+
+int RtpClient::Create(SOCKET fd, int time_rate, RtpReactor* reactor)
+{
+    std::lock_guard<std::mutex> lg(_locker);
+    if (_running)
+    {
+        return 0;
+    }
+
+    if (!_tcp_v4)
+    {
+        _tcp_v4 = new RTSPTCPTransmitter(&_memory_pool, _log_tag);
+    }
+
+    bool threadsafe = false;
+#ifdef RTP_SUPPORT_THREAD
+    threadsafe = true;
+#endif // RTP_SUPPORT_THREAD
+
+    _session_param.SetOwnTimestampUnit(1.0 / (double)time_rate);
+    _session_param.SetAcceptOwnPackets(true);
+    _session_param.SetProbationType(RTPSources::NoProbation);
+    _session_param.SetMaximumPacketSize(1500);
+#ifdef RTP_SUPPORT_THREAD
+    // the socket is drained by Run() as soon as it turns readable
+    _session_param.SetUsePollThread(false);
+#endif
+
+    int res = 0;
+    if ((res = _tcp_v4->Init(threadsafe)) >= 0 &&
+        (res = _tcp_v4->Create(65535, nullptr)) >= 0 &&
+        (res = _udp_session.Create(_session_param, _tcp_v4)) >= 0)
+    {
+        _udp_session.AddDestination(RTPTCPAddress(fd));
+    }
+
     if (res < 0)
     {
-        std::cerr << RTPGetErrorString(res) << std::endl;
-    }
-    else
-    {
-        _running = true;
-        _thread = std::thread(&RtpClient::Run, this);
-    }
-
-    return res;
-}
-
-int RtpClient::Create(const Endpoint& server, const Endpoint& client, int time_rate)
-{
-    std::lock_guard<std::mutex> lg(_locker);
-    if (_running)
-    {
-        return 0;
-    }
-
-    _session_param.SetOwnTimestampUnit(1.0 / (double)time_rate);
-    _session_param.SetAcceptOwnPackets(true);
-    _session_param.SetProbationType(RTPSources::NoProbation);
-
-    _udp_v4.SetPortbase(client.rtp_port);
-    _udp_v4.SetForcedRTCPPort(client.rtcp_port);
-    int res = _udp_session.Create(_session_param, &_udp_v4, RTPTransmitter::IPv4UDPProto);
+        LOG_ERROR(_log_tag.c_str(), "%s", RTPGetErrorString(res).c_str());
+    }
+    else
+    {
+        _statistics.Reset(time_rate);
+        _clock.Reset(time_rate);
+        _reactor = reactor;
+        if ((res = start(&fd, 1)) < 0)
+        {
+            LOG_ERROR(_log_tag.c_str(), "watch rtp socket error: %d", errno);
+            _udp_session.Destroy();
+        }
+    }
+
+    return res;
+}
+
+int RtpClient::Create(const Endpoint& server, const Endpoint& client, int time_rate, RtpReactor* reactor)
+{
+    std::lock_guard<std::mutex> lg(_locker);
+    if (_running)
+    {
+        return 0;
+    }
+
+    if (RECV_NATIVE_UDP == _backend)
+    {
+        int res = _udp_receiver.Create(client);
+        if (res < 0)
+        {
+            LOG_ERROR(_log_tag.c_str(), "bind rtp ports error: %u-%u", client.rtp_port, client.rtcp_port);
+        }
+        else
+        {
+            SOCKET fds[2] = { _udp_receiver.GetRTPSocket(), _udp_receiver.GetRTCPSocket() };
+            configureSockets(fds, 2);
+
+            {
+                std::lock_guard<std::mutex> drop_lg(_drop_locker);
+                _native_udp = true;
+            }
+            _statistics.Reset(time_rate);
+            _clock.Reset(time_rate);
+            _reactor = reactor;
+            if ((res = start(fds, 2)) < 0)
+            {
+                LOG_ERROR(_log_tag.c_str(), "watch rtp sockets error: %d", errno);
+                {
+                    std::lock_guard<std::mutex> drop_lg(_drop_locker);
+                    _native_udp = false;
+                    _drop_socket_count = 0;
+                }
+                _udp_receiver.Destroy();
+            }
+        }
+        return res;
+    }
+
+    _session_param.SetOwnTimestampUnit(1.0 / (double)time_rate);
+    _session_param.SetAcceptOwnPackets(true);
+    _session_param.SetProbationType(RTPSources::NoProbation);
+#ifdef RTP_SUPPORT_THREAD
+    // the sockets are drained by Run() as soon as they turn readable
+    _session_param.SetUsePollThread(false);
+#endif
+
+    _udp_v4.SetPortbase(client.rtp_port);
+    _udp_v4.SetForcedRTCPPort(client.rtcp_port);
+    int res = _udp_session.Create(_session_param, &_udp_v4, RTPTransmitter::IPv4UDPProto);
     if (res < 0)
     {
-        std::cerr << RTPGetErrorString(res) << std::endl;
-    }
-    else
+        LOG_ERROR(_log_tag.c_str(), "%s", RTPGetErrorString(res).c_str());
+    }
+    else
     {
         RTPIPv4Address addr(ntohl(inet_addr(server.address.c_str())), server.rtp_port, server.rtcp_port);
-        res = _udp_session.AddDestination(addr);
+        res = _udp_session.AddDestination(addr);
+        if (res < 0)
+        {
+            LOG_ERROR(_log_tag.c_str(), "%s", RTPGetErrorString(res).c_str());
+        }
+        else
+        {
+            SOCKET fds[2];
+            int count = 0;
+
+            _statistics.Reset(time_rate);
+            _clock.Reset(time_rate);
+            _reactor = reactor;
+            if ((res = getSockets(fds, count)) >= 0)
+            {
+                configureSockets(fds, count);
+                res = start(fds, count);
+            }
+            if (res < 0)
+            {
+                LOG_ERROR(_log_tag.c_str(), "watch rtp sockets error: %d", errno);
+                {
+                    std::lock_guard<std::mutex> drop_lg(_drop_locker);
+                    _drop_socket_count = 0;
+                }
+                _udp_session.Destroy();
+            }
+        }
+    }
+    return res;
+}
+
+int RtpClient::Create(InterleavedDemuxer* demuxer, int rtp_channel, int rtcp_channel, int time_rate)
+{
+    std::lock_guard<std::mutex> lg(_locker);
+    if (_running)
+    {
+        return 0;
+    }
+    if (!demuxer || rtp_channel < 0)
+    {
+        return -1;
+    }
+
+    _statistics.Reset(time_rate);
+    _clock.Reset(time_rate);
+
+    _demuxer = demuxer;
+    _rtp_channel = rtp_channel;
+    _rtcp_channel = rtcp_channel;
+    _running = true;
+    _demuxer->SetChannel(_rtp_channel, this);
+    if (_rtcp_channel >= 0)
+    {
+        _demuxer->SetChannel(_rtcp_channel, this);
+    }
+    return 0;
+}
+
+int RtpClient::Create(const MulticastEndpoint& multicast, int time_rate)
+{
+    std::lock_guard<std::mutex> lg(_locker);
+    if (_running)
+    {
+        return 0;
+    }
+
+    MulticastGroup* group = MulticastGroup::Join(multicast);
+    if (!group)
+    {
+        LOG_ERROR(_log_tag.c_str(), "join multicast group %s:%u error", multicast.group.c_str(), multicast.rtp_port);
+        return -1;
+    }
+
+    int requested = (_receive_buffer > 0) ? _receive_buffer : s_default_receive_buffer.load();
+    int granted = group->ReserveReceiveBuffer(requested);
+    if (granted < 0)
+    {
+        LOG_WARN(_log_tag.c_str(), "set rtp receive buffer error: %d", errno);
+    }
+    else
+    {
+        _granted_buffer = granted;
+    }
+
+    _statistics.Reset(time_rate);
+    _clock.Reset(time_rate);
+
+    // the group thread hands over the packets the same way the interleaved demuxer does
+    _rtp_channel = 0;
+    _rtcp_channel = 1;
+    _running = true;
+    _multicast = group;
+    group->Subscribe(this, _rtp_channel, _rtcp_channel);
+    return 0;
+}
+
+void RtpClient::Destroy()
+{
+    if (_running.exchange(false))
+    {
+        _notifier.Notify();
+        _space.Notify();
+#ifdef RTSP_COROUTINE
+        wakeAsyncWaiter();
+#endif
+
+        // nothing may poll the session any more when it is torn down
+        if (_demuxer)
+        {
+            _demuxer->SetChannel(_rtp_channel, nullptr);
+            _demuxer->SetChannel(_rtcp_channel, nullptr);
+            _demuxer = nullptr;
+        }
+        else if (_multicast)
+        {
+            MulticastGroup* multicast = nullptr;
+            {
+                std::lock_guard<std::mutex> drop_lg(_drop_locker);
+                multicast = _multicast.exchange(nullptr);
+            }
+            multicast->Unsubscribe(this);
+            MulticastGroup::Leave(multicast);
+        }
+        else if (_reactor)
+        {
+            _reactor->Unregister(this);
+            _reactor = nullptr;
+        }
+        else
+        {
+            _poller.Wakeup();
+            if (_thread.joinable())
+            {
+                _thread.join();
+            }
+            _poller.Destroy();
+        }
+
+        // the next Create is a new stream, none of the reorder or reassembly state may carry over
+        _jitter.Reset([this](const Payload& payload) { releasePayload(payload); });
+        if (_depacketizer)
+        {
+            _depacketizer->Reset();
+        }
+
+        bool native_udp = false;
+        {
+            std::lock_guard<std::mutex> drop_lg(_drop_locker);
+            _drop_socket_count = 0;
+            native_udp = _native_udp;
+            _native_udp = false;
+        }
+        _granted_buffer = 0;
+        if (native_udp)
+        {
+            _udp_receiver.Destroy();
+        }
+        else if (_rtp_channel < 0)
+        {
+            _udp_session.BYEDestroy(RTPTime(10, 0), 0, 0);
+        }
+        _rtp_channel = _rtcp_channel = -1;
+    }
+    if (_tcp_v4)
+    {
+        _tcp_v4->Destroy();
+        delete _tcp_v4;
+        _tcp_v4 = nullptr;
+    }
+}
+
+int RtpClient::FetchData(unsigned char* data, int needed)
+{
+#ifdef WAIT_TILL_DATA
+    return FetchData(data, needed, std::chrono::steady_clock::time_point::max());
+#else
+    _notifier.WaitFor(std::chrono::milliseconds(10), [this]() { return pending(); });
+    return copyData(data, needed);
+#endif
+}
+
+int RtpClient::FetchData(unsigned char* data, int needed, const std::chrono::steady_clock::time_point& deadline, CancellationToken* token)
+{
+    CancellationToken::Subscription subscription(token, &_notifier);
+
+    int fetched = 0;
+    while (true)
+    {
+        fetched += copyData(data + fetched, needed - fetched);
+        if (fetched >= needed || !_running || (token && token->Cancelled()))
+        {
+            break;
+        }
+
+        // Destroy and Cancel both notify, the predicate tells them apart from new data
+        if (!_notifier.WaitUntil(deadline, [this, token]() { return pending() || !_running || (token && token->Cancelled()); }))
+        {
+            break;
+        }
+    }
+    return fetched;
+}
+
+int RtpClient::copyData(unsigned char* data, int needed)
+{
+    int fetched = 0;
+    Payload* front = nullptr;
+    while (needed > 0 && (front = frontPayload()) != nullptr)
+    {
+        Payload& payload = *front;
+        if (payload.len > needed)
+        {
+            memcpy(data + fetched, payload.curr, needed);
+            payload.curr += needed;
+            payload.len -= needed;
+
+            fetched += needed;
+            needed = 0;
+        } 
+        else if (payload.len == needed)
+        {
+            memcpy(data + fetched, payload.curr, needed);
+            fetched += needed;
+            needed = 0;
+
+            releasePayload(payload);
+            pop();
+        }
+        else
+        {
+            memcpy(data + fetched, payload.curr, payload.len);
+            fetched += payload.len;
+            needed -= payload.len;
+
+            releasePayload(payload);
+            pop();
+        }
+    }
+    return fetched;
+}
+
+int RtpClient::BorrowPackets(PacketView* views, int max)
+{
+    int count = 0;
+    _notifier.WaitFor(std::chrono::milliseconds(10), [this]() { return pending(); });
+    Payload* front = nullptr;
+    while (count < max && (front = frontPayload()) != nullptr)
+    {
+        fillView(*front, views[count++]);
+        pop();
+    }
+    return count;
+}
+
+void RtpClient::fillView(const Payload& payload, PacketView& view)
+{
+    view.data = payload.payload;
+    view.length = payload.payload_len;
+    view.timestamp = payload.timestamp;
+    view.sequence = payload.sequence;
+    view.ssrc = payload.ssrc;
+    view.marker = payload.marker;
+    view.payload_type = payload.payload_type;
+    view.packet = payload.packet;
+    view.datagram = payload.datagram;
+    view.buffer = payload.buffer;
+}
+
+void RtpClient::SetSink(Sink* sink)
+{
+    std::lock_guard<std::mutex> lg(_locker);
+    if (!_running)
+    {
+        _sink = sink;
+    }
+}
+
+int RtpClient::SetCodec(const std::string& codec, RtpDepacketizer::Format format, const std::string& fmtp)
+{
+    std::lock_guard<std::mutex> lg(_locker);
+    if (_running)
+    {
+        return -1;
+    }
+
+    RtpDepacketizer* depacketizer = RtpDepacketizer::Create(codec, format, fmtp);
+    if (!depacketizer)
+    {
+        return -1;
+    }
+
+    delete _depacketizer;
+    _depacketizer = depacketizer;
+    return 0;
+}
+
+int RtpClient::FetchFrame(RtpDepacketizer::Frame& frame)
+{
+    if (!_depacketizer)
+    {
+        return -1;
+    }
+
+    while (true)
+    {
+        if (popFrame(frame) > 0)
+        {
+            return 1;
+        }
+
+        if (!_notifier.WaitFor(std::chrono::milliseconds(10), [this]() { return pending(); }))
+        {
+            return 0;
+        }
+    }
+}
+
+int RtpClient::popFrame(RtpDepacketizer::Frame& frame)
+{
+    // a packet may complete more than one frame, hand those out before pushing the next one
+    if (_depacketizer->PopFrame(frame))
+    {
+        return 1;
+    }
+
+    Payload* payload = nullptr;
+    while ((payload = frontPayload()) != nullptr)
+    {
+        _depacketizer->Push(payload->payload, payload->payload_len, payload->timestamp, payload->sequence, payload->marker);
+        releasePayload(*payload);
+        pop();
+
+        if (_depacketizer->PopFrame(frame))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void RtpClient::ReleasePackets(const PacketView* views, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        if (views[i].packet)
+        {
+            _udp_session.DeletePacket(views[i].packet);
+        }
+        else if (views[i].datagram)
+        {
+            _udp_receiver.Release(views[i].datagram);
+        }
+        else if (views[i].buffer)
+        {
+            _memory_pool.FreeBuffer(views[i].buffer);
+        }
+    }
+}
+
+void RtpClient::ClearData()
+{
+    Payload* payload = nullptr;
+    while ((payload = frontPayload()) != nullptr)
+    {
+        releasePayload(*payload);
+        pop();
+    }
+}
+
+void RtpClient::SetJitterBuffer(int depth_packets, int depth_ms)
+{
+    std::lock_guard<std::mutex> lg(_locker);
+    if (!_running)
+    {
+        _jitter.SetDepth(depth_packets, depth_ms);
+    }
+}
+
+void RtpClient::SetPacketLossCallback(PacketLossCallback callback, void* userdata)
+{
+    std::lock_guard<std::mutex> lg(_locker);
+    if (!_running)
+    {
+        _loss_callback = callback;
+        _loss_userdata = userdata;
+    }
+}
+
+void RtpClient::SetQueueCapacity(size_t packets, size_t bytes)
+{
+    std::lock_guard<std::mutex> lg(_locker);
+    if (!_running && packets > 0)
+    {
+        ClearData();
+        _payloads.Reset(packets);
+        _max_packets = packets;
+        _max_bytes = bytes;
+    }
+}
+
+void RtpClient::SetOverflowPolicy(OverflowPolicy policy)
+{
+    std::lock_guard<std::mutex> lg(_locker);
+    if (!_running)
+    {
+        _policy = policy;
+        _waiting_keyframe = false;
+    }
+}
+
+RtpClient::QueueStatistics RtpClient::GetQueueStatistics() const
+{
+    QueueStatistics statistics;
+    statistics.packets = _payloads.Size();
+    statistics.bytes = _queued_bytes;
+    statistics.dropped_newest = _dropped_newest;
+    statistics.dropped_oldest = _dropped_oldest;
+    statistics.dropped_until_keyframe = _dropped_until_keyframe;
+    statistics.blocked = _blocked;
+    return statistics;
+}
+
+RtpStatistics RtpClient::GetStatistics() const
+{
+    RtpStatistics statistics = _statistics.Get();
+    statistics.kernel_dropped = GetKernelDropCount();
+    return statistics;
+}
+
+void RtpClient::SetDefaultReceiveBuffer(int bytes)
+{
+    s_default_receive_buffer = bytes;
+}
+
+long long RtpClient::GetKernelDropCount() const
+{
+    std::lock_guard<std::mutex> lg(_drop_locker);
+    if (_native_udp)
+    {
+        return (long long)_udp_receiver.GetOverflowCount();
+    }
+    MulticastGroup* multicast = _multicast;
+    if (multicast)
+    {
+        // of the shared sockets, every client of the group lost these
+        return (long long)multicast->GetOverflowCount();
+    }
+
+    // jrtplib reads its sockets with plain recvfrom, ask the socket itself
+    long long total = -1;
+    int count = _drop_socket_count;
+    for (int i = 0; i < count; ++i)
+    {
+        long long drops = UdpReceiver::GetSocketDrops(_drop_sockets[i]);
+        if (drops >= 0)
+        {
+            total = (total < 0) ? drops : total + drops;
+        }
+    }
+    return total;
+}
+
+int RtpClient::getSockets(SOCKET* fds, int& count)
+{
+    RTPUDPv4TransmissionInfo* info = static_cast<RTPUDPv4TransmissionInfo*>(_udp_session.GetTransmissionInfo());
+    if (!info)
+    {
+        return -1;
+    }
+
+    count = 0;
+    fds[count++] = info->GetRTPSocket();
+    if (info->GetRTCPSocket() != info->GetRTPSocket())
+    {
+        fds[count++] = info->GetRTCPSocket();
+    }
+    _udp_session.DeleteTransmissionInfo(info);
+    return 0;
+}
+
+void RtpClient::configureSockets(const SOCKET* fds, int count)
+{
+    int requested = (_receive_buffer > 0) ? _receive_buffer : s_default_receive_buffer.load();
+    int granted = UdpReceiver::SetReceiveBuffer(fds[0], requested);
+    if (granted < 0)
+    {
+        LOG_WARN(_log_tag.c_str(), "set rtp receive buffer error: %d", errno);
+    }
+    else
+    {
+#ifdef __linux__
+        // the kernel doubles the request for its bookkeeping overhead
+        if (granted / 2 < requested)
+#else
+        if (granted < requested)
+#endif
+        {
+            LOG_WARN(_log_tag.c_str(), "rtp receive buffer limited to %d of %d bytes, raise net.core.rmem_max", granted, requested);
+        }
+        _granted_buffer = granted;
+    }
+
+    std::lock_guard<std::mutex> drop_lg(_drop_locker);
+    for (int i = 0; i < count && i < 2; ++i)
+    {
+        _drop_sockets[i] = fds[i];
+    }
+    _drop_socket_count = (count < 2) ? count : 2;
+}
+
+int RtpClient::start(const SOCKET* fds, int count)
+{
+    int res = 0;
+    _running = true;
+    if (_reactor)
+    {
+        res = _reactor->Register(this, fds, count);
+    }
+    else if ((res = _poller.Create()) >= 0)
+    {
+        for (int i = 0; i < count && res >= 0; ++i)
+        {
+            res = _poller.Add(fds[i], this);
+        }
+
+        if (res >= 0)
+        {
+            _thread = std::thread(&RtpClient::Run, this);
+        }
+        else
+        {
+            _poller.Destroy();
+        }
+    }
+
+    if (res < 0)
+    {
+        _running = false;
+        _reactor = nullptr;
+    }
+    return res;
+}
+
+void RtpClient::Run()
+{
+    void* ready[2];
+    while (_running)
+    {
+        // sleep until a datagram arrives or a jitter buffer gap times out
+        int timeout = _jitter.GetTimeout(std::chrono::steady_clock::now());
+        if (timeout < 0 || timeout > RTP_POLL_TIMEOUT_MS)
+        {
+            timeout = RTP_POLL_TIMEOUT_MS;
+        }
+        if (_poller.Wait(ready, 2, timeout) < 0)
+        {
+            LOG_ERROR(_log_tag.c_str(), "wait rtp sockets error: %d", errno);
+            RTPTime::Wait(RTPTime(0, 5000));
+        }
+        if (!_running)
+        {
+            break;
+        }
+
+        receive();
+    }
+}
+
+void RtpClient::OnReactorEvent()
+{
+    receive();
+}
+
+void RtpClient::receive()
+{
+    if (_native_udp)
+    {
+        // _datagrams is only a scratch list, FeedData takes over the datagrams
+        if (_udp_receiver.Receive(_datagrams, &_rtcp_datagrams) < 0)
+        {
+            LOG_ERROR(_log_tag.c_str(), "receive rtp error: %d", errno);
+        }
+        for (UdpReceiver::Datagram* datagram : _rtcp_datagrams)
+        {
+            _clock.OnRtcpPacket(datagram->data, datagram->size);
+            _udp_receiver.Release(datagram);
+        }
+        _rtcp_datagrams.clear();
+        if (!_datagrams.empty())
+        {
+            FeedData(_datagrams);
+            _datagrams.clear();
+        }
+    }
+    else
+    {
+        int res = _udp_session.Poll();
         if (res < 0)
         {
-            std::cerr << RTPGetErrorString(res) << std::endl;
-        }
-        else
-        {
-            _running = true;
-            _thread = std::thread(&RtpClient::Run, this);
-        }
-    }
-    return res;
-}
-
-void RtpClient::Destroy()
-{
-    std::lock_guard<std::mutex> lg(_locker);
-    if (_running)
-    {
-        _udp_session.BYEDestroy(RTPTime(10, 0), 0, 0);
-
-        _running = false;
-        _condition.notify_all();
-    }
-    if (_tcp_v4)
-    {
-        _tcp_v4->Destroy();
-        delete _tcp_v4;
-        _tcp_v4 = nullptr;
-    }
-}
-
-int RtpClient::FetchData(unsigned char* data, int needed)
-{
-    int fetched = 0;
-#ifdef WAIT_TILL_DATA
-    while (needed > 0)
-    {
-        std::unique_lock<std::mutex> ul(_locker);
-        _condition.wait_for(ul, std::chrono::milliseconds(10), [this]() { return !_payloads.empty(); });
-        if (!_payloads.empty())
-        {
-            Payload& payload = _payloads.front();
-            if (payload.len > needed)
-            {
-                memcpy(data + fetched, payload.curr, needed);
-                payload.curr += needed;
-                payload.len -= needed;
-
-                fetched += needed;
-                needed = 0;
-            }
-            else if (payload.len == needed)
-            {
-                memcpy(data + fetched, payload.curr, needed);
-                fetched += needed;
-                needed = 0;
-
-                _udp_session.DeletePacket(payload.packet);
-                _payloads.pop();
-            }
-            else
-            {
-                memcpy(data + fetched, payload.curr, payload.len);
-                fetched += payload.len;
-                needed -= payload.len;
-
-                _udp_session.DeletePacket(payload.packet);
-                _payloads.pop();
-            }
-        }
-    }
-#else
-    std::unique_lock<std::mutex> ul(_locker);
-    _condition.wait_for(ul, std::chrono::milliseconds(10), [this]() { return !_payloads.empty(); });
-    while (!_payloads.empty() && needed > 0)
-    {
-        Payload& payload = _payloads.front();
-        if (payload.len > needed)
-        {
-            memcpy(data + fetched, payload.curr, needed);
-            payload.curr += needed;
-            payload.len -= needed;
-
-            fetched += needed;
-            needed = 0;
-        } 
-        else if (payload.len == needed)
-        {
-            memcpy(data + fetched, payload.curr, needed);
-            fetched += needed;
-            needed = 0;
-
-            _udp_session.DeletePacket(payload.packet);
-            _payloads.pop();
-        }
-        else
-        {
-            memcpy(data + fetched, payload.curr, payload.len);
-            fetched += payload.len;
-            needed -= payload.len;
-
-            _udp_session.DeletePacket(payload.packet);
-            _payloads.pop();
-        }
-    }
-#endif
-    return fetched;
-}
-
-void RtpClient::ClearData()
-{
-    std::lock_guard<std::mutex> lg(_locker);
-    while (!_payloads.empty())
-    {
-        Payload& payload = _payloads.front();
-        _udp_session.DeletePacket(payload.packet);
-        _payloads.pop();
-    }
-}
-
-void RtpClient::Run()
-{
-    while (_running)
-    {
-        std::list<RTPPacket*> packets;
-
+            LOG_WARN(_log_tag.c_str(), "%s", RTPGetErrorString(res).c_str());
+        }
+
+        std::list<RTPPacket*> packets;
+
         _udp_session.BeginDataAccess();
         // check incoming packets
         if (_udp_session.GotoFirstSourceWithData())
@@ -232,35 +796,488 @@ void RtpClient::Run()
                 }
             } while (_udp_session.GotoNextSourceWithData());
         }
-        _udp_session.EndDataAccess();
-
-        if (!packets.empty())
-        {
-            FeedData(packets);
-        }
-
-#ifndef RTP_SUPPORT_THREAD
-        int res = _udp_session.Poll();
-        if (res < 0)
+        // sender reports, OnSenderReport skips the ones already seen
+        if (_udp_session.GotoFirstSource())
         {
-            std::cerr << RTPGetErrorString(res) << std::endl;
-        }
-#endif
-
-        RTPTime::Wait(RTPTime(0, 5000));
-    }
-}
-
-void RtpClient::FeedData(const std::list<RTPPacket*>& packets)
-{
-    std::lock_guard<std::mutex> lg(_locker);
-    for (RTPPacket* packet : packets)
-    {
-        std::cout << "recv: " << (int)packet->GetSSRC() << ", " << (int)packet->GetPayloadType() << ", " << packet->GetSequenceNumber() << ", " << packet->GetPacketLength() << std::endl;
-
-        _payloads.emplace(Payload(packet));
-    }
-    _condition.notify_one();
-}
-
-
+            do
+            {
+                RTPSourceData* source = _udp_session.GetCurrentSourceInfo();
+                if (source && source->SR_HasInfo())
+                {
+                    RTPNTPTime ntp = source->SR_GetNTPTimestamp();
+                    _clock.OnSenderReport(source->GetSSRC(), ntp.GetMSW(), ntp.GetLSW(), source->SR_GetRTPTimestamp());
+                }
+            } while (_udp_session.GotoNextSource());
+        }
+        _udp_session.EndDataAccess();
+
+        if (!packets.empty())
+        {
+            FeedData(packets);
+        }
+    }
+
+    expire();
+}
+
+void RtpClient::OnInterleavedFrame(int channel, const unsigned char* data, int size)
+{
+    if (channel == _rtp_channel)
+    {
+        if (size > UDP_DATAGRAM_SIZE)
+        {
+            onLargeFrame(data, size);
+            return;
+        }
+
+        UdpReceiver::Datagram* datagram = _udp_receiver.Acquire();
+        if (!datagram)
+        {
+            // the consumer holds the whole pool, the sequence gap reports the frame as lost
+            return;
+        }
+        memcpy(datagram->data, data, size);
+        datagram->size = size;
+        _datagrams.push_back(datagram);
+    }
+    else if (channel == _rtcp_channel)
+    {
+        _clock.OnRtcpPacket(data, size);
+    }
+}
+
+void RtpClient::onLargeFrame(const unsigned char* data, int size)
+{
+    // the frames before it go first, the queue keeps the order they arrived in
+    if (!_datagrams.empty())
+    {
+        FeedData(_datagrams);
+        _datagrams.clear();
+    }
+
+    unsigned char* buffer = (unsigned char*)_memory_pool.AllocateBuffer((size_t)size, RTPMEM_TYPE_BUFFER_RECEIVEDRTPPACKET);
+    if (!buffer)
+    {
+        _statistics.OnDropped((size_t)size);
+        return;
+    }
+    memcpy(buffer, data, size);
+
+    Payload payload(buffer, size);
+    if (payload.payload_len < 0)
+    {
+        _memory_pool.FreeBuffer(buffer);
+        return;
+    }
+
+    enqueue(payload, std::chrono::steady_clock::now());
+    publish();
+}
+
+void RtpClient::OnInterleavedBatchEnd()
+{
+    // _datagrams is only a scratch list, FeedData takes over the datagrams
+    if (!_datagrams.empty())
+    {
+        FeedData(_datagrams);
+        _datagrams.clear();
+    }
+    expire();
+}
+
+void RtpClient::expire()
+{
+    if (_jitter.Enabled())
+    {
+        // a gap may time out without any new arrival
+        size_t queued = _payloads.Size();
+        _jitter.Expire(std::chrono::steady_clock::now(),
+            [this](const Payload& payload) { pushPayload(payload); },
+            [this](uint16_t first_sequence, int count) { onPacketLoss(first_sequence, count); });
+        if (_sink || _payloads.Size() != queued)
+        {
+            publish();
+        }
+    }
+}
+
+void RtpClient::FeedData(const std::list<RTPPacket*>& packets)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    for (RTPPacket* packet : packets)
+    {
+        LOG_TRACE(_log_tag.c_str(), "recv: %08x, %d, %u, %d", packet->GetSSRC(), (int)packet->GetPayloadType(),
+            packet->GetSequenceNumber(), (int)packet->GetPacketLength());
+
+        enqueue(Payload(packet), now);
+    }
+    publish();
+}
+
+void RtpClient::FeedData(const std::vector<UdpReceiver::Datagram*>& datagrams)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    for (UdpReceiver::Datagram* datagram : datagrams)
+    {
+        Payload payload(datagram);
+        if (payload.payload_len < 0)
+        {
+            _udp_receiver.Release(datagram);
+            continue;
+        }
+
+        enqueue(payload, now);
+    }
+    publish();
+}
+
+void RtpClient::enqueue(const Payload& payload, const std::chrono::steady_clock::time_point& now)
+{
+    _statistics.OnPacket(payload.sequence, payload.timestamp, (size_t)payload.size, now);
+
+    if (!_jitter.Enabled())
+    {
+        pushPayload(payload);
+    }
+    else if (!_jitter.Insert(payload.sequence, payload, now,
+        [this](const Payload& payload) { pushPayload(payload); },
+        [this](uint16_t first_sequence, int count) { onPacketLoss(first_sequence, count); }))
+    {
+        // late or duplicated
+        _statistics.OnDropped((size_t)payload.size);
+        releasePayload(payload);
+    }
+}
+
+void RtpClient::pushPayload(const Payload& payload)
+{
+    if (_sink)
+    {
+        _sink_batch.push_back(payload);
+        return;
+    }
+
+    if (_waiting_keyframe)
+    {
+        if (!isKeyframeStart(payload))
+        {
+            dropPayload(payload, _dropped_until_keyframe);
+            return;
+        }
+        _waiting_keyframe = false;
+    }
+
+    bool queued = tryPush(payload);
+    if (!queued)
+    {
+        switch (_policy)
+        {
+        case OVERFLOW_DROP_OLDEST:
+            for (int i = 0; i < RTP_QUEUE_EVICT_TRIES && !queued; ++i)
+            {
+                Payload oldest;
+                if (_payloads.Evict(oldest))
+                {
+                    _queued_bytes -= (size_t)oldest.size;
+                    dropPayload(oldest, _dropped_oldest);
+                }
+                queued = tryPush(payload);
+            }
+            break;
+
+        case OVERFLOW_BLOCK:
+            ++_blocked;
+            while (!queued && _running)
+            {
+                size_t bytes = (size_t)payload.size;
+                _space.WaitFor(std::chrono::milliseconds(RTP_QUEUE_BLOCK_WAIT_MS), [this, bytes]() { return hasRoom(bytes) || !_running; });
+                queued = tryPush(payload);
+            }
+            break;
+
+        case OVERFLOW_DROP_UNTIL_KEYFRAME:
+            // the frames after the gap can not be decoded anyway, free the queue up for the next keyframe
+            if (_depacketizer)
+            {
+                _waiting_keyframe = true;
+                dropPayload(payload, _dropped_until_keyframe);
+                return;
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    if (queued)
+    {
+        _statistics.OnQueued(_payloads.Size());
+    }
+    else
+    {
+        dropPayload(payload, _dropped_newest);
+    }
+}
+
+bool RtpClient::hasRoom(size_t bytes) const
+{
+    if (_payloads.Size() >= _max_packets)
+    {
+        return false;
+    }
+    size_t queued = _queued_bytes;
+    return _max_bytes == 0 || queued == 0 || queued + bytes <= _max_bytes;
+}
+
+bool RtpClient::tryPush(const Payload& payload)
+{
+    if (!hasRoom((size_t)payload.size))
+    {
+        return false;
+    }
+
+    // counted before the consumer can see the packet, it takes the bytes off again when it claims it
+    _queued_bytes += (size_t)payload.size;
+    if (!_payloads.Push(payload))
+    {
+        _queued_bytes -= (size_t)payload.size;
+        return false;
+    }
+    return true;
+}
+
+bool RtpClient::isKeyframeStart(const Payload& payload) const
+{
+    // only set while the session is stopped, reading it from the receive thread is safe
+    return !_depacketizer || _depacketizer->IsKeyframeStart(payload.payload, payload.payload_len);
+}
+
+void RtpClient::dropPayload(const Payload& payload, std::atomic<unsigned long long>& counter)
+{
+    _statistics.OnDropped((size_t)payload.size);
+    releasePayload(payload);
+    ++counter;
+    ++_dropped;
+}
+
+void RtpClient::publish()
+{
+    if (_sink)
+    {
+        deliver();
+    }
+    else
+    {
+        _notifier.Notify();
+#ifdef RTSP_COROUTINE
+        wakeAsyncWaiter();
+#endif
+    }
+}
+
+void RtpClient::deliver()
+{
+    if (_sink_batch.empty())
+    {
+        return;
+    }
+
+    if (_depacketizer)
+    {
+        // frames are only valid until the next Push, hand them over packet by packet
+        RtpDepacketizer::Frame frame;
+        for (const Payload& payload : _sink_batch)
+        {
+            _depacketizer->Push(payload.payload, payload.payload_len, payload.timestamp, payload.sequence, payload.marker);
+            releasePayload(payload);
+
+            _sink_frames.clear();
+            while (_depacketizer->PopFrame(frame))
+            {
+                _sink_frames.push_back(frame);
+            }
+            if (!_sink_frames.empty())
+            {
+                _sink->OnFrames(_sink_frames.data(), (int)_sink_frames.size());
+            }
+        }
+    }
+    else
+    {
+        _sink_views.resize(_sink_batch.size());
+        for (size_t i = 0; i < _sink_batch.size(); ++i)
+        {
+            fillView(_sink_batch[i], _sink_views[i]);
+        }
+        _sink->OnPackets(_sink_views.data(), (int)_sink_views.size());
+
+        for (const Payload& payload : _sink_batch)
+        {
+            releasePayload(payload);
+        }
+    }
+    _sink_batch.clear();
+}
+
+void RtpClient::onPacketLoss(uint16_t first_sequence, int count)
+{
+    if (_loss_callback)
+    {
+        _loss_callback(_loss_userdata, first_sequence, count);
+    }
+}
+
+RtpClient::Payload::Payload(UdpReceiver::Datagram* datagram)
+{
+    this->datagram = datagram;
+    this->head = datagram->data;
+    this->size = datagram->size;
+    this->curr = head;
+    this->len = size;
+    parse();
+}
+
+RtpClient::Payload::Payload(unsigned char* buffer, int size)
+{
+    this->buffer = buffer;
+    this->head = buffer;
+    this->size = size;
+    this->curr = head;
+    this->len = size;
+    parse();
+}
+
+void RtpClient::Payload::parse()
+{
+    /* RFC3550.5.1, anything that is not a well-formed version 2 packet keeps payload_len at -1 */
+    const unsigned char* data = head;
+    int offset = 12;
+    if (size < offset || (data[0] >> 6) != 2)
+    {
+        return;
+    }
+
+    offset += (data[0] & 0x0F) * 4;
+    if ((data[0] & 0x10) && size >= offset + 4)
+    {
+        offset += 4 + (((int)data[offset + 2] << 8) | data[offset + 3]) * 4;
+    }
+    else if (data[0] & 0x10)
+    {
+        return;
+    }
+
+    int padding = (data[0] & 0x20) ? data[size - 1] : 0;
+    if (size < offset + padding)
+    {
+        return;
+    }
+
+    this->payload = head + offset;
+    this->payload_len = size - offset - padding;
+    this->timestamp = ((uint32_t)data[4] << 24) | ((uint32_t)data[5] << 16) | ((uint32_t)data[6] << 8) | data[7];
+    this->sequence = (uint16_t)((data[2] << 8) | data[3]);
+    this->ssrc = ((uint32_t)data[8] << 24) | ((uint32_t)data[9] << 16) | ((uint32_t)data[10] << 8) | data[11];
+    this->marker = (data[1] & 0x80) != 0;
+    this->payload_type = data[1] & 0x7F;
+}
+
+RtpClient::Payload* RtpClient::frontPayload()
+{
+    if (!_current_valid && _payloads.Pop(_current))
+    {
+        _current_valid = true;
+        _queued_bytes -= (size_t)_current.size;
+        if (OVERFLOW_BLOCK == _policy)
+        {
+            _space.Notify();
+        }
+    }
+    return _current_valid ? &_current : nullptr;
+}
+
+void RtpClient::releasePayload(const Payload& payload)
+{
+    if (payload.packet)
+    {
+        _udp_session.DeletePacket(payload.packet);
+    }
+    else if (payload.datagram)
+    {
+        _udp_receiver.Release(payload.datagram);
+    }
+    else if (payload.buffer)
+    {
+        _memory_pool.FreeBuffer(payload.buffer);
+    }
+}
+
+#ifdef RTSP_COROUTINE
+
+Task<int> RtpClient::NextFrame(EventLoop& loop, RtpDepacketizer::Frame& frame)
+{
+    if (!_depacketizer)
+    {
+        co_return -1;
+    }
+
+    while (true)
+    {
+        if (popFrame(frame) > 0)
+        {
+            co_return 1;
+        }
+        if (!_running)
+        {
+            co_return -1;
+        }
+
+        // packets that do not complete a frame yet resume us too, go around again
+        co_await PacketAwaiter(this, &loop);
+    }
+}
+
+RtpClient::PacketAwaiter::~PacketAwaiter()
+{
+    // the coroutine was destroyed while waiting, the producer must not resume it any more
+    AsyncWaiter* expected = &_waiter;
+    if (!_client->_async_waiter.compare_exchange_strong(expected, nullptr))
+    {
+        // a producer may have taken the waiter and still be reading it, the storage goes with us
+        while (_client->_async_waking.load() > 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool RtpClient::PacketAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    _waiter.handle = handle;
+    _client->_async_waiter.store(&_waiter);
+
+    // pairs with the fence in EventNotifier::Notify: either the producer sees us or we see its packet
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_client->pending() || !_client->_running)
+    {
+        // whoever takes the waiter back resumes the coroutine, if the producer got it first it is posted already
+        AsyncWaiter* expected = &_waiter;
+        return !_client->_async_waiter.compare_exchange_strong(expected, nullptr);
+    }
+    return true;
+}
+
+void RtpClient::wakeAsyncWaiter()
+{
+    // announced before the waiter is taken, so ~PacketAwaiter sees it whenever its exchange loses
+    ++_async_waking;
+    AsyncWaiter* waiter = _async_waiter.exchange(nullptr);
+    if (waiter)
+    {
+        waiter->loop->Post(waiter->handle);
+    }
+    --_async_waking;
+}
+
+#endif // RTSP_COROUTINE
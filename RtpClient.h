@@ -1,25 +1,40 @@
-
-/*****************************************************************************
-*                                                                            *
-*  @file     RTParserImpl.h                                                  *
-*  @brief    RTParser implement class declaration                            *
-*                                                                            *
-*  Details.                                                                  *
-*                                                                            *
-*  @author   ZhiGao.Wu                                                       *
-*  @email    wuzhigaoem@gmail.com                                            *
-*  @date     2019/05/08                                                      *
-*                                                                            *
-*----------------------------------------------------------------------------*
-*  Remark   :                                                                *
-*                                                                            *
-*****************************************************************************/
-
-#ifndef __RTP_CLIENT_HEADER_H__
-#define __RTP_CLIENT_HEADER_H__
-
-#include "Common.h"
-
+
+/*****************************************************************************
+*                                                                            *
+*  @file     RTParserImpl.h                                                  *
+*  @brief    RTParser implement class declaration                            *
+*                                                                            *
+*  Details.                                                                  *
+*                                                                            *
+*  @author   ZhiGao.Wu                                                       *
+*  @email    wuzhigaoem@gmail.com                                            *
+*  @date     2019/05/08                                                      *
+*                                                                            *
+*----------------------------------------------------------------------------*
+*  Remark   :                                                                *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef __RTP_CLIENT_HEADER_H__
+#define __RTP_CLIENT_HEADER_H__
+
+#include "Common.h"
+#include "EventPoller.h"
+#include "RtpReactor.h"
+#include "UdpReceiver.h"
+#include "SpscRing.h"
+#include "EventNotifier.h"
+#include "EventLoop.h"
+#include "CancellationToken.h"
+#include "RtpMemoryPool.h"
+#include "JitterBuffer.h"
+#include "RtpStatistics.h"
+#include "RtpClockMapper.h"
+#include "InterleavedDemuxer.h"
+#include "MulticastGroup.h"
+#include "RtpDepacketizer.h"
+#include "Logger.h"
+
 #include "jrtplib3/rtpsession.h"
 #include "jrtplib3/rtpudpv4transmitter.h"
 #include "jrtplib3/rtpudpv6transmitter.h"
@@ -28,130 +43,468 @@
 #include "jrtplib3/rtptcpaddress.h"
 #include "jrtplib3/rtpsessionparams.h"
 #include "jrtplib3/rtperrors.h"
-#include "jrtplib3/rtplibraryversion.h"
-#include "jrtplib3/rtpsourcedata.h"
-
-#include <iostream>
-
-#include <thread>
-#include <mutex>
-#include <condition_variable>
-
-#include <queue>
-
-using namespace jrtplib;
-
-class RtpClient
-{
-private:
-    class RTPTCPSession : public RTPSession
-    {
-    public:
-        RTPTCPSession() : RTPSession() { }
-        ~RTPTCPSession() { }
-    protected:
-        void OnValidatedRTPPacket(RTPSourceData *srcdat, RTPPacket *rtppack, bool isonprobation, bool *ispackethandled)
-        {
-            printf("SSRC %x Got packet (%d bytes) in OnValidatedRTPPacket from source 0x%04x!\n", GetLocalSSRC(),
-                (int)rtppack->GetPayloadLength(), srcdat->GetSSRC());
-            DeletePacket(rtppack);
-            *ispackethandled = true;
-        }
-
-        void OnRTCPSDESItem(RTPSourceData *srcdat, RTCPSDESPacket::ItemType t, const void *itemdata, size_t itemlength)
-        {
-            char msg[1024];
-
-            memset(msg, 0, sizeof(msg));
-            if (itemlength >= sizeof(msg))
-                itemlength = sizeof(msg) - 1;
-
-            memcpy(msg, itemdata, itemlength);
-            printf("SSRC %x Received SDES item (%d): %s from SSRC %x\n", GetLocalSSRC(), (int)t, msg, srcdat->GetSSRC());
-        }
-    };
-
-    class RTSPTCPTransmitter : public RTPTCPTransmitter
-    {
-    public:
-        RTSPTCPTransmitter()
-            : RTPTCPTransmitter(NULL)
-        { }
-
-        void OnSendError(SocketType sock)
-        {
-            std::cerr << "Error sending over socket " << sock << ", removing destination" << std::endl;
-            DeleteDestination(RTPTCPAddress(sock));
-        }
-
-        void OnReceiveError(SocketType sock)
-        {
-            std::cerr << "Error receiving from socket " << sock << ", removing destination" << std::endl;
-            DeleteDestination(RTPTCPAddress(sock));
-        }
-    };
-
-    typedef RTPSession RTPUDPSession;
-
-public:
-    RtpClient();
-    ~RtpClient();
-
-    int Create(SOCKET fd, int time_rate);
-    int Create(const Endpoint& server, const Endpoint& client, int time_rate);
-    void Destroy();
-
-    int FetchData(unsigned char* data, int needed);
-    void ClearData();
-
-private:
-    void Run();
-
-private:
-    void FeedData(const std::list<RTPPacket*>& packets);
-
+#include "jrtplib3/rtplibraryversion.h"
+#include "jrtplib3/rtpsourcedata.h"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+
+#include <vector>
+
+using namespace jrtplib;
+
+class RtpClient : private RtpReactor::Session, private InterleavedDemuxer::Channel
+{
 private:
-    RTPSessionParams _session_param;
-
-private:
-    RTPUDPv4TransmissionParams _udp_v4;
-    RTPUDPSession _udp_session;
-
-private:
-    RTSPTCPTransmitter* _tcp_v4;
-    RTPTCPSession _tcp_session;
-
-private:
-    bool _running;
-    std::thread _thread;
-    std::mutex _locker;
-    std::condition_variable _condition;
-
-    struct Payload
-    {
-        RTPPacket* packet = nullptr;
-
-        unsigned char* head = nullptr;
-        int size = 0;
-        unsigned char* curr = nullptr;
-        int len = 0;
-
-        Payload(RTPPacket* packet)
-        {
-            this->packet = packet;
-            //this->head = packet->GetPayloadData();
-            //this->size = (int)(packet->GetPayloadLength());
-            this->head = packet->GetPacketData();
-            this->size = (int)(packet->GetPacketLength());
-            this->curr = head;
-            this->len = size;
-        }
-    };
-    std::queue<Payload> _payloads;
-    
-private:
-    RtpClient& operator=(RtpClient& rhs);
-};
-
-#endif
-
+    class RTPTCPSession : public RTPSession
+    {
+    public:
+        RTPTCPSession(const std::string& tag) : RTPSession(), _tag(tag) { }
+        ~RTPTCPSession() { }
+    protected:
+        void OnValidatedRTPPacket(RTPSourceData *srcdat, RTPPacket *rtppack, bool isonprobation, bool *ispackethandled)
+        {
+            LOG_TRACE(_tag.c_str(), "SSRC %x Got packet (%d bytes) in OnValidatedRTPPacket from source 0x%04x",
+                GetLocalSSRC(), (int)rtppack->GetPayloadLength(), srcdat->GetSSRC());
+            DeletePacket(rtppack);
+            *ispackethandled = true;
+        }
+
+        void OnRTCPSDESItem(RTPSourceData *srcdat, RTCPSDESPacket::ItemType t, const void *itemdata, size_t itemlength)
+        {
+            LOG_DEBUG(_tag.c_str(), "SSRC %x Received SDES item (%d): %.*s from SSRC %x",
+                GetLocalSSRC(), (int)t, (int)itemlength, (const char*)itemdata, srcdat->GetSSRC());
+        }
+
+    private:
+        const std::string& _tag;
+    };
+
+    class RTSPTCPTransmitter : public RTPTCPTransmitter
+    {
+    public:
+        RTSPTCPTransmitter(RTPMemoryManager* mgr, const std::string& tag)
+            : RTPTCPTransmitter(mgr), _tag(tag)
+        { }
+
+        void OnSendError(SocketType sock)
+        {
+            LOG_ERROR(_tag.c_str(), "Error sending over socket %d, removing destination", (int)sock);
+            DeleteDestination(RTPTCPAddress(sock));
+        }
+
+        void OnReceiveError(SocketType sock)
+        {
+            LOG_ERROR(_tag.c_str(), "Error receiving from socket %d, removing destination", (int)sock);
+            DeleteDestination(RTPTCPAddress(sock));
+        }
+
+    private:
+        const std::string& _tag;
+    };
+
+    typedef RTPSession RTPUDPSession;
+
+public:
+    enum ReceiveBackend
+    {
+        RECV_JRTPLIB = 0,
+        RECV_NATIVE_UDP     // recvmmsg batches straight from the sockets, no RTCP receiver reports are sent
+    };
+
+    /* What happens to a packet that arrives while the receive queue is at its limit */
+    enum OverflowPolicy
+    {
+        OVERFLOW_DROP_NEWEST = 0,       // the arriving packet is dropped
+        OVERFLOW_DROP_OLDEST,           // queued packets are dropped, oldest first, until it fits
+        OVERFLOW_BLOCK,                 // the receive thread waits for the consumer, the kernel or the server drops instead
+        OVERFLOW_DROP_UNTIL_KEYFRAME    // the arriving packet and all after it are dropped until a keyframe starts
+    };
+
+    /* Drop counters of the receive queue, each packet is counted once under the policy that dropped it */
+    struct QueueStatistics
+    {
+        size_t packets = 0;                             // queued right now
+        size_t bytes = 0;
+        unsigned long long dropped_newest = 0;
+        unsigned long long dropped_oldest = 0;
+        unsigned long long dropped_until_keyframe = 0;
+        unsigned long long blocked = 0;                 // times the receive thread had to wait for room
+    };
+
+    /* Read-only view onto a received packet, valid until handed back with ReleasePackets */
+    struct PacketView
+    {
+        const unsigned char* data = nullptr;    // RTP payload, header stripped
+        int length = 0;
+        uint32_t timestamp = 0;
+        uint16_t sequence = 0;
+        uint32_t ssrc = 0;
+        bool marker = false;
+        unsigned char payload_type = 0;
+
+        // owner of the bytes, only meaningful to ReleasePackets
+        RTPPacket* packet = nullptr;
+        UdpReceiver::Datagram* datagram = nullptr;
+        unsigned char* buffer = nullptr;        // from the memory pool
+    };
+
+    /* Called on the receive thread for every run of sequence numbers the jitter buffer gave up on */
+    typedef void(*PacketLossCallback)(void* userdata, uint16_t first_sequence, int count);
+
+    /* Push delivery, called inline on the receive thread instead of queueing for FetchData (see SetSink).
+    * Everything handed in is only valid for the length of the call */
+    class Sink
+    {
+    public:
+        virtual ~Sink() { }
+
+        /* Every packet received by one wakeup of the receive thread, in sequence order if the jitter buffer is on */
+        virtual void OnPackets(const PacketView* views, int count) = 0;
+
+        /* Instead of OnPackets when a codec is set: the frames completed by one packet */
+        virtual void OnFrames(const RtpDepacketizer::Frame* /*frames*/, int /*count*/) { }
+    };
+
+public:
+    RtpClient();
+    ~RtpClient();
+
+    /* Prefix of every log line of this session, e.g. the camera name. Must be called before Create */
+    inline void SetLogTag(const std::string& tag) { _log_tag = tag; }
+
+    /* Select how a UDP session receives, must be called before Create. RTP over TCP always uses jrtplib */
+    inline void SetReceiveBackend(ReceiveBackend backend) { _backend = backend; }
+
+    /* reactor:
+    *    if set, the session is driven by one of the reactor threads instead of a thread of its own,
+    *    the reactor must outlive the client
+    * */
+    int Create(SOCKET fd, int time_rate, RtpReactor* reactor = nullptr);
+
+    /* RTP over the RTSP connection: receive the interleaved channels of one media from the demuxer
+    * of its RtspClient (see RtspClient::GetInterleavedDemuxer and GetMediaChannels). Packets are
+    * handled on the demuxer thread, the demuxer must outlive the client. Native UDP datagrams
+    * are used as buffers, packets above UDP_DATAGRAM_SIZE bytes are copied into the memory pool instead. */
+    int Create(InterleavedDemuxer* demuxer, int rtp_channel, int rtcp_channel, int time_rate);
+    int Create(const Endpoint& server, const Endpoint& client, int time_rate, RtpReactor* reactor = nullptr);
+
+    /* Receive a multicast group, see RtspClient::GetMediaMulticast. Clients of the same group in this process
+    * share one socket pair and the thread reading it, each client gets a copy of every packet on that thread.
+    * SetReceiveBuffer only grows the shared socket, and no RTCP receiver reports are sent. */
+    int Create(const MulticastEndpoint& multicast, int time_rate);
+    void Destroy();
+
+    /* FetchData, ClearData, BorrowPackets and GetDroppedCount form the consumer side of a
+    * single-producer/single-consumer queue, only one thread may call them at a time */
+    int FetchData(unsigned char* data, int needed);
+
+    /* Copy exactly 'needed' bytes, waiting for them as long as it takes. Returns early only when the deadline
+    * passes, 'token' is cancelled or the client is destroyed, each of which ends the wait at once.
+    * return:
+    *    bytes copied, less than needed if it returned early
+    * */
+    int FetchData(unsigned char* data, int needed, const std::chrono::steady_clock::time_point& deadline, CancellationToken* token = nullptr);
+    void ClearData();
+
+    /* Deliver to 'sink' on the receive thread instead of the queue, must be called before Create.
+    * FetchData, FetchFrame and BorrowPackets then never return anything. The sink blocks everything else
+    * on the same receive thread while it runs, and is not called any more once Destroy returned */
+    void SetSink(Sink* sink);
+
+    /* Limit of the receive queue, must be called before Create. bytes counts whole RTP packets, 0 means no byte limit.
+    * A packet larger than the byte limit is still queued when the queue is empty */
+    void SetQueueCapacity(size_t packets, size_t bytes = 0);
+
+    /* Must be called before Create. OVERFLOW_BLOCK stalls everything else on the same receive thread,
+    * a shared reactor thread or the RTSP connection of interleaved sessions. OVERFLOW_DROP_UNTIL_KEYFRAME
+    * needs SetCodec to tell keyframes apart, without a codec it drops like OVERFLOW_DROP_NEWEST */
+    void SetOverflowPolicy(OverflowPolicy policy);
+
+    /* Total of all queue drops */
+    inline unsigned long long GetDroppedCount() const { return _dropped; }
+    QueueStatistics GetQueueStatistics() const;
+
+    /* Reorder packets by RTP sequence number before they are queued, must be called before Create.
+    * A missing packet is reported lost once more than depth_packets packets wait behind it or the first
+    * of them waited depth_ms, whichever comes first. 0 disables a limit, both 0 (default) disables reordering.
+    * With a reactor, depth_ms is only checked on packet arrival and on the reactor tick.
+    * */
+    void SetJitterBuffer(int depth_packets, int depth_ms);
+    void SetPacketLossCallback(PacketLossCallback callback, void* userdata);
+    inline JitterStatistics GetJitterStatistics() const { return _jitter.GetStatistics(); }
+
+    /* Receive counters of this session, safe from any thread */
+    RtpStatistics GetStatistics() const;
+
+    /* Kernel receive queue of the UDP RTP socket in bytes, for sessions that do not call SetReceiveBuffer.
+    * Applies to sessions created afterwards, beyond net.core.rmem_max only with CAP_NET_ADMIN */
+    static void SetDefaultReceiveBuffer(int bytes);
+
+    /* Kernel receive queue of this session's UDP RTP socket, must be called before Create. 0 uses the default */
+    inline void SetReceiveBuffer(int bytes) { _receive_buffer = bytes; }
+
+    /* Size the kernel actually granted (Linux reports twice the requested size), 0 before Create or for TCP */
+    inline int GetReceiveBuffer() const { return _granted_buffer; }
+
+    /* Datagrams the kernel dropped because the socket receive queue was full, -1 if the platform can not tell */
+    long long GetKernelDropCount() const;
+
+    /* Sender wall-clock time of an RTP timestamp, from the RTCP sender reports of the stream 'ssrc'.
+    * Safe from any thread. Converted times drift smoothly, they do not jump with every report.
+    * return:
+    *    -1 until the first sender report of the stream arrived
+    * */
+    inline int ToWallclock(uint32_t ssrc, uint32_t timestamp, std::chrono::system_clock::time_point& wallclock) const
+    {
+        return _clock.ToWallclock(ssrc, timestamp, wallclock);
+    }
+
+    /* Same, for the stream that sent the latest report */
+    inline int ToWallclock(uint32_t timestamp, std::chrono::system_clock::time_point& wallclock) const
+    {
+        return _clock.ToWallclock(timestamp, wallclock);
+    }
+
+    /* Allocation counters of the pool jrtplib allocates this session's packets from */
+    inline RtpMemoryPool::Statistics GetMemoryStatistics() const { return _memory_pool.GetStatistics(); }
+
+    /* Zero-copy alternative to FetchData: lend out up to 'max' queued packets without copying them.
+    * Waits the same 10 ms as FetchData when nothing is queued. Do not mix with FetchData on one client,
+    * a view always covers the whole payload.
+    * return:
+    *    number of views filled in
+    * */
+    int BorrowPackets(PacketView* views, int max);
+
+    /* Return borrowed packets, safe from any thread, must happen before the client is destructed */
+    void ReleasePackets(const PacketView* views, int count);
+
+    /* Reassemble whole frames for FetchFrame, must be called before Create.
+    * codec: the rtpmap encoding name, see RtspClient::GetMediaCodec
+    * fmtp: the fmtp parameters, see RtspClient::GetMediaFmtp, needed by MPEG4-GENERIC
+    * return:
+    *    -1 if the codec is not supported
+    * */
+    int SetCodec(const std::string& codec, RtpDepacketizer::Format format = RtpDepacketizer::FORMAT_ANNEXB, const std::string& fmtp = "");
+
+    /* Next complete frame, frame.data stays valid until the next FetchFrame. Consumer side like FetchData, do not mix them.
+    * return:
+    *    1 with a frame, 0 if none completed within 10 ms, -1 if no codec is set
+    * */
+    int FetchFrame(RtpDepacketizer::Frame& frame);
+
+#ifdef RTSP_COROUTINE
+    /* Awaitable FetchFrame, the coroutine is resumed on 'loop' once a frame completed:
+    *    while (co_await rtp.NextFrame(loop, frame) > 0) { ... }
+    * Consumer side like FetchFrame, 'frame' must stay valid until the task finished.
+    * return:
+    *    1 with a frame, -1 if no codec is set or the client is not running (any more)
+    * */
+    Task<int> NextFrame(EventLoop& loop, RtpDepacketizer::Frame& frame);
+#endif
+
+private:
+    int getSockets(SOCKET* fds, int& count);
+    void configureSockets(const SOCKET* fds, int count);
+    int start(const SOCKET* fds, int count);
+
+    void Run();
+    void OnReactorEvent();
+    void receive();
+    void expire();
+
+    void OnInterleavedFrame(int channel, const unsigned char* data, int size);
+    void onLargeFrame(const unsigned char* data, int size);
+    void OnInterleavedBatchEnd();
+
+private:
+    void FeedData(const std::list<RTPPacket*>& packets);
+    void FeedData(const std::vector<UdpReceiver::Datagram*>& datagrams);
+
+private:
+    // declared ahead of the sessions, they log and give their memory back while being destructed
+    std::string _log_tag;
+    RtpMemoryPool _memory_pool;
+
+private:
+    RTPSessionParams _session_param;
+
+private:
+    RTPUDPv4TransmissionParams _udp_v4;
+    RTPUDPSession _udp_session;
+
+private:
+    RTSPTCPTransmitter* _tcp_v4;
+    RTPTCPSession _tcp_session;
+
+private:
+    ReceiveBackend _backend;
+    bool _native_udp;
+    UdpReceiver _udp_receiver;
+    std::vector<UdpReceiver::Datagram*> _datagrams;
+    std::vector<UdpReceiver::Datagram*> _rtcp_datagrams;
+
+private:
+    InterleavedDemuxer* _demuxer;
+    std::atomic<MulticastGroup*> _multicast;
+    int _rtp_channel;
+    int _rtcp_channel;
+
+private:
+    std::atomic<bool> _running;
+    RtpReactor* _reactor;
+    EventPoller _poller;
+    std::thread _thread;
+    std::mutex _locker;     // Create/Destroy only, the data path is lock-free
+    EventNotifier _notifier;
+
+    struct Payload
+    {
+        // exactly one of them owns the bytes
+        RTPPacket* packet = nullptr;
+        UdpReceiver::Datagram* datagram = nullptr;
+        unsigned char* buffer = nullptr;        // from _memory_pool, interleaved packets too big for a datagram
+
+        unsigned char* head = nullptr;
+        int size = 0;
+        unsigned char* curr = nullptr;
+        int len = 0;
+
+        unsigned char* payload = nullptr;
+        int payload_len = -1;   // -1: malformed packet
+        uint32_t timestamp = 0;
+        uint16_t sequence = 0;
+        uint32_t ssrc = 0;
+        bool marker = false;
+        unsigned char payload_type = 0;
+
+        Payload() { }
+
+        Payload(RTPPacket* packet)
+        {
+            this->packet = packet;
+            //this->head = packet->GetPayloadData();
+            //this->size = (int)(packet->GetPayloadLength());
+            this->head = packet->GetPacketData();
+            this->size = (int)(packet->GetPacketLength());
+            this->curr = head;
+            this->len = size;
+
+            this->payload = packet->GetPayloadData();
+            this->payload_len = (int)(packet->GetPayloadLength());
+            this->timestamp = packet->GetTimestamp();
+            this->sequence = packet->GetSequenceNumber();
+            this->ssrc = packet->GetSSRC();
+            this->marker = packet->HasMarker();
+            this->payload_type = packet->GetPayloadType();
+        }
+
+        Payload(UdpReceiver::Datagram* datagram);
+        Payload(unsigned char* buffer, int size);
+
+        void parse();
+    };
+    SpscRing<Payload> _payloads;
+    size_t _max_packets;
+    size_t _max_bytes;
+    std::atomic<size_t> _queued_bytes;
+    OverflowPolicy _policy;
+    EventNotifier _space;       // OVERFLOW_BLOCK: the consumer made room
+
+    // consumer side only, the packet FetchData is in the middle of
+    Payload _current;
+    bool _current_valid;
+
+    // producer side only
+    bool _waiting_keyframe;
+
+    std::atomic<unsigned long long> _dropped;
+    std::atomic<unsigned long long> _dropped_newest;
+    std::atomic<unsigned long long> _dropped_oldest;
+    std::atomic<unsigned long long> _dropped_until_keyframe;
+    std::atomic<unsigned long long> _blocked;
+
+    // kernel side of the UDP sockets
+    int _receive_buffer;
+    std::atomic<int> _granted_buffer;
+
+    // GetKernelDropCount is done with the sockets before they close, also guards _native_udp and _multicast there
+    mutable std::mutex _drop_locker;
+    SOCKET _drop_sockets[2];
+    int _drop_socket_count;
+
+    void releasePayload(const Payload& payload);
+
+    Payload* frontPayload();
+    int copyData(unsigned char* data, int needed);
+    int popFrame(RtpDepacketizer::Frame& frame);
+    static void fillView(const Payload& payload, PacketView& view);
+
+    void publish();
+    void deliver();
+    inline void pop() { _current_valid = false; }
+    inline bool pending() const { return _current_valid || !_payloads.Empty(); }
+
+    bool hasRoom(size_t bytes) const;
+    bool tryPush(const Payload& payload);
+    bool isKeyframeStart(const Payload& payload) const;
+    void dropPayload(const Payload& payload, std::atomic<unsigned long long>& counter);
+
+    void enqueue(const Payload& payload, const std::chrono::steady_clock::time_point& now);
+    void pushPayload(const Payload& payload);
+    void onPacketLoss(uint16_t first_sequence, int count);
+
+    // consumer side only, the receive thread with a sink
+    RtpDepacketizer* _depacketizer;
+
+    // producer side only
+    Sink* _sink;
+    std::vector<Payload> _sink_batch;
+    std::vector<PacketView> _sink_views;
+    std::vector<RtpDepacketizer::Frame> _sink_frames;
+
+#ifdef RTSP_COROUTINE
+    // a NextFrame suspended until packets arrive, handed to its loop by the producer
+    struct AsyncWaiter
+    {
+        EventLoop* loop;
+        std::coroutine_handle<> handle;
+    };
+
+    class PacketAwaiter
+    {
+    public:
+        PacketAwaiter(RtpClient* client, EventLoop* loop) : _client(client), _waiter{ loop, nullptr } { }
+        ~PacketAwaiter();
+
+        bool await_ready() const { return _client->pending() || !_client->_running; }
+        bool await_suspend(std::coroutine_handle<> handle);
+        void await_resume() const { }
+
+    private:
+        RtpClient* _client;
+        AsyncWaiter _waiter;
+    };
+
+    std::atomic<AsyncWaiter*> _async_waiter;
+    std::atomic<int> _async_waking;     // producers inside wakeAsyncWaiter, a PacketAwaiter outlives them
+    void wakeAsyncWaiter();
+#endif
+
+    // written by the producer side, readable from any thread
+    RtpStatisticsCollector _statistics;
+    RtpClockMapper _clock;
+
+    // producer side only
+    JitterBuffer<Payload> _jitter;
+    PacketLossCallback _loss_callback;
+    void* _loss_userdata;
+    
+private:
+    RtpClient& operator=(RtpClient& rhs);
+};
+
+#endif
+
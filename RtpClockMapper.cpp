@@ -0,0 +1,156 @@
+
+#include "RtpClockMapper.h"
+
+#include <math.h>
+
+/* RFC3550.6.4.1 */
+#define RTCP_PT_SR              200
+
+// seconds between the NTP (1900) and the Unix (1970) epoch
+#define NTP_UNIX_OFFSET         2208988800.0
+
+// weight of a new report in the rate and offset estimates
+#define CLOCK_SMOOTHING         (1.0 / 8.0)
+
+// a measured rate this far from nominal is a timestamp discontinuity, not drift, the mapping restarts
+#define CLOCK_MAX_RATE_ERROR    0.05
+
+// an offset error this large means the sender clock was stepped, the mapping restarts
+#define CLOCK_MAX_OFFSET_ERROR  1.0
+
+RtpClockMapper::RtpClockMapper()
+    : _reported(), _locker(), _mappings(), _clock_rate(90000.0), _latest_ssrc(0), _has_latest(false)
+{
+}
+
+RtpClockMapper::~RtpClockMapper()
+{
+}
+
+void RtpClockMapper::Reset(int clock_rate)
+{
+    _reported.clear();
+
+    std::lock_guard<std::mutex> lg(_locker);
+    _mappings.clear();
+    _clock_rate = (clock_rate > 0) ? (double)clock_rate : 90000.0;
+    _has_latest = false;
+}
+
+void RtpClockMapper::OnSenderReport(uint32_t ssrc, uint32_t ntp_msw, uint32_t ntp_lsw, uint32_t rtp_timestamp)
+{
+    uint64_t raw = ((uint64_t)ntp_msw << 32) | ntp_lsw;
+    std::map<uint32_t, uint64_t>::iterator reported = _reported.find(ssrc);
+    if (reported != _reported.end() && reported->second == raw)
+    {
+        return;
+    }
+    _reported[ssrc] = raw;
+
+    double ntp = (double)ntp_msw + (double)ntp_lsw / 4294967296.0;
+
+    std::lock_guard<std::mutex> lg(_locker);
+    std::map<uint32_t, Mapping>::iterator it = _mappings.find(ssrc);
+    if (it == _mappings.end())
+    {
+        Mapping& mapping = _mappings[ssrc];
+        mapping.anchor_rtp = rtp_timestamp;
+        mapping.anchor_ntp = ntp;
+        mapping.rate = _clock_rate;
+        mapping.report_rtp = rtp_timestamp;
+        mapping.report_ntp = ntp;
+    }
+    else
+    {
+        Mapping& mapping = it->second;
+        double elapsed = ntp - mapping.report_ntp;
+        double ticks = (double)(int32_t)(rtp_timestamp - mapping.report_rtp);
+        bool discontinuity = elapsed <= 0.0;
+        if (!discontinuity)
+        {
+            double measured = ticks / elapsed;
+            if (fabs(measured - _clock_rate) <= _clock_rate * CLOCK_MAX_RATE_ERROR)
+            {
+                mapping.rate += (measured - mapping.rate) * CLOCK_SMOOTHING;
+            }
+            else
+            {
+                discontinuity = true;
+            }
+        }
+
+        // move the anchor to this report, only part of the way towards the time it claims
+        double predicted = mapping.anchor_ntp + (double)(int32_t)(rtp_timestamp - mapping.anchor_rtp) / mapping.rate;
+        double error = ntp - predicted;
+        if (discontinuity || fabs(error) > CLOCK_MAX_OFFSET_ERROR)
+        {
+            mapping.anchor_ntp = ntp;
+            mapping.rate = _clock_rate;
+        }
+        else
+        {
+            mapping.anchor_ntp = predicted + error * CLOCK_SMOOTHING;
+        }
+        mapping.anchor_rtp = rtp_timestamp;
+
+        mapping.report_rtp = rtp_timestamp;
+        mapping.report_ntp = ntp;
+    }
+
+    _latest_ssrc = ssrc;
+    _has_latest = true;
+}
+
+void RtpClockMapper::OnRtcpPacket(const unsigned char* data, int size)
+{
+    /* RFC3550.6.4.1, a compound packet is a run of packets each giving its length in 32-bit words minus one */
+    int offset = 0;
+    while (offset + 4 <= size)
+    {
+        const unsigned char* packet = data + offset;
+        int length = ((((int)packet[2] << 8) | packet[3]) + 1) * 4;
+        if ((packet[0] >> 6) != 2 || offset + length > size)
+        {
+            break;
+        }
+
+        if (RTCP_PT_SR == packet[1] && length >= 28)
+        {
+            uint32_t ssrc = ((uint32_t)packet[4] << 24) | ((uint32_t)packet[5] << 16) | ((uint32_t)packet[6] << 8) | packet[7];
+            uint32_t ntp_msw = ((uint32_t)packet[8] << 24) | ((uint32_t)packet[9] << 16) | ((uint32_t)packet[10] << 8) | packet[11];
+            uint32_t ntp_lsw = ((uint32_t)packet[12] << 24) | ((uint32_t)packet[13] << 16) | ((uint32_t)packet[14] << 8) | packet[15];
+            uint32_t rtp_timestamp = ((uint32_t)packet[16] << 24) | ((uint32_t)packet[17] << 16) | ((uint32_t)packet[18] << 8) | packet[19];
+            OnSenderReport(ssrc, ntp_msw, ntp_lsw, rtp_timestamp);
+        }
+        offset += length;
+    }
+}
+
+int RtpClockMapper::ToWallclock(uint32_t ssrc, uint32_t timestamp, std::chrono::system_clock::time_point& wallclock) const
+{
+    std::lock_guard<std::mutex> lg(_locker);
+    std::map<uint32_t, Mapping>::const_iterator it = _mappings.find(ssrc);
+    if (it == _mappings.end())
+    {
+        return -1;
+    }
+    return toWallclock(it->second, timestamp, wallclock);
+}
+
+int RtpClockMapper::ToWallclock(uint32_t timestamp, std::chrono::system_clock::time_point& wallclock) const
+{
+    if (!_has_latest)
+    {
+        return -1;
+    }
+    return ToWallclock(_latest_ssrc, timestamp, wallclock);
+}
+
+int RtpClockMapper::toWallclock(const Mapping& mapping, uint32_t timestamp, std::chrono::system_clock::time_point& wallclock) const
+{
+    double ntp = mapping.anchor_ntp + (double)(int32_t)(timestamp - mapping.anchor_rtp) / mapping.rate;
+    double unix_seconds = ntp - NTP_UNIX_OFFSET;
+    wallclock = std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+        std::chrono::duration<double>(unix_seconds)));
+    return 0;
+}
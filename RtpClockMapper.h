@@ -0,0 +1,83 @@
+
+/*****************************************************************************
+*                                                                            *
+*  @file     RtpClockMapper.h                                                *
+*  @brief    RTP timestamp to wall-clock mapping from RTCP sender reports    *
+*                                                                            *
+*  Details.                                                                  *
+*    Every sender report pairs an NTP time with an RTP timestamp. The        *
+*    clock rate of each SSRC is estimated from consecutive reports and the   *
+*    mapping is eased towards each new report, so report jitter and sender   *
+*    clock drift do not make converted times jump.                           *
+*    A report implying a rate more than 5% off nominal, or a time            *
+*    more than a second away from the mapping, restarts it there.            *
+*                                                                            *
+*----------------------------------------------------------------------------*
+*  Remark   :                                                                *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef __RTP_CLOCK_MAPPER_HEADER_H__
+#define __RTP_CLOCK_MAPPER_HEADER_H__
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+
+#include <stdint.h>
+
+class RtpClockMapper
+{
+public:
+    RtpClockMapper();
+    ~RtpClockMapper();
+
+    /* Forget every stream, clock_rate is the nominal RTP timestamp frequency */
+    void Reset(int clock_rate);
+
+    /* producer side: a sender report, repeated reports are ignored */
+    void OnSenderReport(uint32_t ssrc, uint32_t ntp_msw, uint32_t ntp_lsw, uint32_t rtp_timestamp);
+
+    /* producer side: every SR of an RTCP compound packet is passed to OnSenderReport */
+    void OnRtcpPacket(const unsigned char* data, int size);
+
+    /* Wall-clock time of the sender at 'timestamp', safe from any thread.
+    * return:
+    *    -1 if no sender report of that stream arrived yet
+    * */
+    int ToWallclock(uint32_t ssrc, uint32_t timestamp, std::chrono::system_clock::time_point& wallclock) const;
+
+    /* Same for the stream that sent the latest report */
+    int ToWallclock(uint32_t timestamp, std::chrono::system_clock::time_point& wallclock) const;
+
+private:
+    struct Mapping
+    {
+        // the NTP time the mapping assigns to anchor_rtp, seconds since 1900
+        uint32_t anchor_rtp = 0;
+        double anchor_ntp = 0.0;
+        double rate = 0.0;          // estimated timestamp ticks per second
+
+        // the latest report as received
+        uint32_t report_rtp = 0;
+        double report_ntp = 0.0;
+    };
+
+    int toWallclock(const Mapping& mapping, uint32_t timestamp, std::chrono::system_clock::time_point& wallclock) const;
+
+private:
+    std::map<uint32_t, uint64_t> _reported;     // producer side only, the last raw NTP time per SSRC
+
+    mutable std::mutex _locker;     // taken once per new sender report on the producer side
+    std::map<uint32_t, Mapping> _mappings;
+    double _clock_rate;
+    std::atomic<uint32_t> _latest_ssrc;
+    std::atomic<bool> _has_latest;
+
+private:
+    RtpClockMapper(const RtpClockMapper& rhs);
+    RtpClockMapper& operator=(const RtpClockMapper& rhs);
+};
+
+#endif
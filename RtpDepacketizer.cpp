@@ -0,0 +1,300 @@
+
+#include "RtpDepacketizer.h"
+#include "H264Depacketizer.h"
+#include "H265Depacketizer.h"
+#include "AacDepacketizer.h"
+
+#include <string.h>
+#ifdef _MSC_VER
+#define strcasecmp _stricmp
+#else
+#include <strings.h>
+#endif
+
+static const unsigned char START_CODE[4] = { 0x00, 0x00, 0x00, 0x01 };
+
+RtpDepacketizer* RtpDepacketizer::Create(const std::string& codec, Format format, const std::string& fmtp)
+{
+    if (strcasecmp(codec.c_str(), "H264") == 0)
+    {
+        return new H264Depacketizer(format);
+    }
+    if (strcasecmp(codec.c_str(), "H265") == 0)
+    {
+        return new H265Depacketizer(format);
+    }
+    if (strcasecmp(codec.c_str(), "MPEG4-GENERIC") == 0)
+    {
+        return new AacDepacketizer(fmtp);
+    }
+    return nullptr;
+}
+
+RtpDepacketizer::RtpDepacketizer(Format format, size_t reserve, const NalSyntax* nal)
+    : _format(format)
+    , _building(), _frame_start(0), _corrupted(false)
+    , _ready(), _frames(), _next_frame(0)
+    , _started(false), _expected_sequence(0)
+    , _nal(nal), _nal_timestamp(0), _nal_keyframe(false)
+    , _nal_fragment(false), _nal_fragment_offset(0)
+{
+    // sized for a typical frame up front so reassembly does not reallocate on the first ones
+    _building.reserve(reserve);
+    _ready.reserve(reserve);
+}
+
+RtpDepacketizer::~RtpDepacketizer()
+{
+}
+
+void RtpDepacketizer::Push(const unsigned char* payload, int length, uint32_t timestamp, uint16_t sequence, bool marker)
+{
+    _frames.clear();
+    _next_frame = 0;
+
+    if (_started && sequence != _expected_sequence)
+    {
+        onLoss();
+    }
+    _started = true;
+    _expected_sequence = sequence + 1;
+
+    if (length > 0)
+    {
+        depacketize(payload, length, timestamp, marker);
+    }
+
+    if (!_frames.empty())
+    {
+        // finished frames move over to _ready, the frame still in progress starts the next buffer
+        _building.swap(_ready);
+        _building.assign(_ready.begin() + _frame_start, _ready.end());
+        _ready.resize(_frame_start);
+        _frame_start = 0;
+    }
+}
+
+bool RtpDepacketizer::PopFrame(Frame& frame)
+{
+    if (_next_frame >= _frames.size())
+    {
+        return false;
+    }
+
+    const FrameInfo& info = _frames[_next_frame++];
+    frame.data = _ready.data() + info.offset;
+    frame.size = (int)info.size;
+    frame.timestamp = info.timestamp;
+    frame.keyframe = info.keyframe;
+    frame.corrupted = info.corrupted;
+    return true;
+}
+
+void RtpDepacketizer::Reset()
+{
+    _building.clear();
+    _frame_start = 0;
+    _corrupted = false;
+    _frames.clear();
+    _next_frame = 0;
+    _started = false;
+    _nal_keyframe = false;
+    _nal_fragment = false;
+}
+
+bool RtpDepacketizer::IsKeyframeStart(const unsigned char* /*payload*/, int length) const
+{
+    return length > 0;
+}
+
+void RtpDepacketizer::onLoss()
+{
+    _corrupted = true;
+    dropNalFragment();
+}
+
+void RtpDepacketizer::depacketizeNal(const unsigned char* payload, int length, uint32_t timestamp, bool marker)
+{
+    // the marker of the last packet went missing, the timestamp still tells the access units apart
+    if (!frameEmpty() && timestamp != _nal_timestamp)
+    {
+        finishNalFrame();
+    }
+    _nal_timestamp = timestamp;
+
+    const int header_size = _nal->header_size;
+    unsigned char type = nalType(payload);
+    if (length < header_size)
+    {
+        markCorrupted();
+    }
+    else if (type >= _nal->first_single && type < _nal->aggregation)
+    {
+        appendNalUnit(payload, length);
+    }
+    else if (_nal->aggregation == type)
+    {
+        /* RFC6184.5.7.1 STAP-A, RFC7798.4.4.2 AP: 16-bit size, then the unit, repeated */
+        int offset = header_size;
+        while (offset + 2 <= length)
+        {
+            int size = (payload[offset] << 8) | payload[offset + 1];
+            offset += 2;
+            if (size < header_size || offset + size > length)
+            {
+                markCorrupted();
+                break;
+            }
+            appendNalUnit(payload + offset, size);
+            offset += size;
+        }
+    }
+    else if (_nal->fragment == type && length > header_size + 1)
+    {
+        /* RFC6184.5.8 FU-A, RFC7798.4.4.3 FU: the FU header after the NAL unit header, S and E bits, then the type */
+        unsigned char fu_header = payload[header_size];
+        unsigned char fu_type = fu_header & _nal->type_mask;
+        if (fu_header & 0x80)
+        {
+            // the end of a previous fragmented unit never arrived
+            dropNalFragment();
+            _nal_fragment = true;
+            _nal_fragment_offset = beginNal();
+
+            // the unit's own header is the payload header with the type from the FU header
+            unsigned char type_bits = (unsigned char)(_nal->type_mask << _nal->type_shift);
+            append((unsigned char)((payload[0] & ~type_bits) | (fu_type << _nal->type_shift)));
+            append(payload + 1, header_size - 1);
+        }
+        else if (!_nal_fragment)
+        {
+            // the start of this unit was lost, nothing to attach the fragment to
+            markCorrupted();
+            return;
+        }
+
+        append(payload + header_size + 1, length - header_size - 1);
+
+        if (fu_header & 0x40)
+        {
+            endNal(_nal_fragment_offset);
+            _nal_fragment = false;
+            if (isKeyframeNal(fu_type))
+            {
+                _nal_keyframe = true;
+            }
+        }
+    }
+    else
+    {
+        // interleaved mode packets (never negotiated), PACI and reserved types carry nothing we can decode
+        markCorrupted();
+    }
+
+    if (marker)
+    {
+        finishNalFrame();
+    }
+}
+
+bool RtpDepacketizer::isNalKeyframeStart(const unsigned char* payload, int length) const
+{
+    const int header_size = _nal->header_size;
+    if (length < header_size + 1)
+    {
+        return false;
+    }
+
+    // parameter sets travel right in front of the picture they belong to
+    unsigned char type = nalType(payload);
+    if (_nal->aggregation == type && length > header_size + 2)
+    {
+        type = nalType(payload + header_size + 2);
+    }
+    else if (_nal->fragment == type)
+    {
+        if (!(payload[header_size] & 0x80))
+        {
+            return false;
+        }
+        type = payload[header_size] & _nal->type_mask;
+    }
+    return startsKeyframeNal(type);
+}
+
+void RtpDepacketizer::appendNalUnit(const unsigned char* nal, size_t size)
+{
+    appendNal(nal, size);
+    if (isKeyframeNal(nalType(nal)))
+    {
+        _nal_keyframe = true;
+    }
+}
+
+void RtpDepacketizer::dropNalFragment()
+{
+    if (_nal_fragment)
+    {
+        truncateFrame(_nal_fragment_offset);
+        _nal_fragment = false;
+        markCorrupted();
+    }
+}
+
+void RtpDepacketizer::finishNalFrame()
+{
+    dropNalFragment();
+    finishFrame(_nal_timestamp, _nal_keyframe);
+    _nal_keyframe = false;
+}
+
+size_t RtpDepacketizer::beginNal()
+{
+    size_t offset = frameSize();
+    if (FORMAT_ANNEXB == _format)
+    {
+        append(START_CODE, sizeof(START_CODE));
+    }
+    else
+    {
+        _building.resize(_building.size() + 4);
+    }
+    return offset;
+}
+
+void RtpDepacketizer::endNal(size_t offset)
+{
+    if (FORMAT_LENGTH_PREFIXED == _format)
+    {
+        unsigned char* prefix = _building.data() + _frame_start + offset;
+        uint32_t size = (uint32_t)(frameSize() - offset - 4);
+        prefix[0] = (unsigned char)(size >> 24);
+        prefix[1] = (unsigned char)(size >> 16);
+        prefix[2] = (unsigned char)(size >> 8);
+        prefix[3] = (unsigned char)size;
+    }
+}
+
+void RtpDepacketizer::appendNal(const unsigned char* nal, size_t size)
+{
+    size_t offset = beginNal();
+    append(nal, size);
+    endNal(offset);
+}
+
+void RtpDepacketizer::finishFrame(uint32_t timestamp, bool keyframe)
+{
+    if (!frameEmpty())
+    {
+        FrameInfo info;
+        info.offset = _frame_start;
+        info.size = frameSize();
+        info.timestamp = timestamp;
+        info.keyframe = keyframe;
+        info.corrupted = _corrupted;
+        _frames.push_back(info);
+
+        _frame_start = _building.size();
+    }
+    _corrupted = false;
+}
@@ -0,0 +1,159 @@
+
+/*****************************************************************************
+*                                                                            *
+*  @file     RtpDepacketizer.h                                               *
+*  @brief    RTP payload to media frame reassembly base class                *
+*                                                                            *
+*  Details.                                                                  *
+*    Packets are pushed in sequence order, completed frames are handed out   *
+*    as views onto a buffer the depacketizer reuses for its whole life.      *
+*                                                                            *
+*----------------------------------------------------------------------------*
+*  Remark   :                                                                *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef __RTP_DEPACKETIZER_HEADER_H__
+#define __RTP_DEPACKETIZER_HEADER_H__
+
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+// initial capacity of the frame buffers of video codecs, a typical keyframe
+#define RTP_DEPACKETIZER_RESERVE    (512 * 1024)
+
+class RtpDepacketizer
+{
+public:
+    enum Format
+    {
+        FORMAT_ANNEXB = 0,          // every NAL unit behind a 00 00 00 01 start code
+        FORMAT_LENGTH_PREFIXED      // every NAL unit behind its 4 byte big-endian size
+    };
+
+    struct Frame
+    {
+        const unsigned char* data = nullptr;
+        int size = 0;
+        uint32_t timestamp = 0;     // RTP timestamp
+        bool keyframe = false;      // always set for audio
+        bool corrupted = false;     // packets of this frame were lost
+    };
+
+public:
+    /* codec: the rtpmap encoding name of the SDP, "H264", "H265" or "MPEG4-GENERIC"
+    * fmtp: the fmtp parameters of the SDP, only used by codecs that need them
+    * return:
+    *    nullptr if the codec is not supported, otherwise delete it when done
+    * */
+    static RtpDepacketizer* Create(const std::string& codec, Format format = FORMAT_ANNEXB, const std::string& fmtp = "");
+
+    virtual ~RtpDepacketizer();
+
+    /* Feed the payload of the next packet, RTP header stripped. Frames returned by PopFrame before are invalidated */
+    void Push(const unsigned char* payload, int length, uint32_t timestamp, uint16_t sequence, bool marker);
+
+    /* Next frame completed by the last Push, valid until the next Push */
+    bool PopFrame(Frame& frame);
+
+    virtual void Reset();
+
+    /* Whether a packet starts a keyframe, judged from its payload alone. Does not touch the reassembly
+    * state, safe from any thread. Every audio packet counts as a keyframe */
+    virtual bool IsKeyframeStart(const unsigned char* payload, int length) const;
+
+protected:
+    /* The payload structures the NAL unit codecs share (RFC6184, RFC7798), which only differ in header widths and type numbers */
+    struct NalSyntax
+    {
+        int header_size;                // NAL unit header, also leading aggregation and fragmentation units
+        int type_shift;                 // the type field of the first header byte
+        unsigned char type_mask;        // also masks the type in the FU header
+        unsigned char first_single;     // single NAL unit packets are the types from here up to 'aggregation'
+        unsigned char aggregation;      // STAP-A, AP
+        unsigned char fragment;         // FU-A, FU
+    };
+
+    /* reserve: initial capacity of the frame buffers
+    * nal: set for NAL unit codecs, which then use depacketizeNal and isNalKeyframeStart with the hooks below */
+    RtpDepacketizer(Format format, size_t reserve, const NalSyntax* nal = nullptr);
+
+    virtual void depacketize(const unsigned char* payload, int length, uint32_t timestamp, bool marker) = 0;
+
+    /* A sequence number was skipped, the frame in progress is missing data */
+    virtual void onLoss();
+
+    /* NAL unit codecs: single units, aggregation and fragmentation units into frames closed by the marker or a new timestamp */
+    void depacketizeNal(const unsigned char* payload, int length, uint32_t timestamp, bool marker);
+    bool isNalKeyframeStart(const unsigned char* payload, int length) const;
+
+    /* per-codec hooks of the NAL unit handling: a random access picture, and a unit that may start one,
+    * the picture itself or a parameter set travelling in front of it */
+    virtual bool isKeyframeNal(unsigned char /*type*/) const { return false; }
+    virtual bool startsKeyframeNal(unsigned char /*type*/) const { return false; }
+
+protected:
+    /* Frame in progress, offsets below are relative to its first byte */
+    inline bool frameEmpty() const { return _building.size() == _frame_start; }
+    inline size_t frameSize() const { return _building.size() - _frame_start; }
+    inline void append(const unsigned char* data, size_t size) { _building.insert(_building.end(), data, data + size); }
+    inline void append(unsigned char byte) { _building.push_back(byte); }
+    inline void truncateFrame(size_t size) { _building.resize(_frame_start + size); }
+
+    /* NAL unit framing in the configured format: beginNal writes the prefix and returns its offset, endNal fixes up the size */
+    size_t beginNal();
+    void endNal(size_t offset);
+    void appendNal(const unsigned char* nal, size_t size);
+
+    /* Close the frame in progress, an empty frame is dropped */
+    void finishFrame(uint32_t timestamp, bool keyframe);
+
+    inline void markCorrupted() { _corrupted = true; }
+
+protected:
+    Format _format;
+
+private:
+    struct FrameInfo
+    {
+        size_t offset;
+        size_t size;
+        uint32_t timestamp;
+        bool keyframe;
+        bool corrupted;
+    };
+
+    std::vector<unsigned char> _building;
+    size_t _frame_start;
+    bool _corrupted;
+
+    std::vector<unsigned char> _ready;
+    std::vector<FrameInfo> _frames;
+    size_t _next_frame;
+
+    bool _started;
+    uint16_t _expected_sequence;
+
+    // NAL unit codecs only
+    const NalSyntax* _nal;
+    uint32_t _nal_timestamp;
+    bool _nal_keyframe;
+    bool _nal_fragment;             // FU in progress
+    size_t _nal_fragment_offset;
+
+private:
+    inline unsigned char nalType(const unsigned char* header) const { return (header[0] >> _nal->type_shift) & _nal->type_mask; }
+
+    void appendNalUnit(const unsigned char* nal, size_t size);
+    void dropNalFragment();
+    void finishNalFrame();
+
+private:
+    RtpDepacketizer(const RtpDepacketizer& rhs);
+    RtpDepacketizer& operator=(const RtpDepacketizer& rhs);
+};
+
+#endif
@@ -0,0 +1,153 @@
+
+#include "RtpMemoryPool.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+
+// every block starts with a header recording its class, FreeBuffer is not told the size
+#define RTP_POOL_HEADER_SIZE        16
+#define RTP_POOL_OVERSIZED          0xFFFFFFFFu
+
+static inline size_t classSize(int index)
+{
+    return (size_t)1 << (RTP_POOL_MIN_CLASS_SHIFT + index);
+}
+
+static inline int classIndex(size_t numbytes)
+{
+    for (int index = 0; index < RTP_POOL_CLASS_COUNT; ++index)
+    {
+        if (numbytes <= classSize(index))
+        {
+            return index;
+        }
+    }
+    return -1;
+}
+
+RtpMemoryPool::RtpMemoryPool()
+    : _allocations(0), _frees(0)
+    , _pool_hits(0), _pool_misses(0), _oversized(0)
+    , _bytes_in_use(0), _bytes_retained(0)
+{
+}
+
+RtpMemoryPool::~RtpMemoryPool()
+{
+    for (SizeClass& size_class : _classes)
+    {
+        while (size_class.free)
+        {
+            Block* block = size_class.free;
+            size_class.free = block->next;
+            free((unsigned char*)block - RTP_POOL_HEADER_SIZE);
+        }
+    }
+}
+
+void *RtpMemoryPool::AllocateBuffer(size_t numbytes, int /*memtype*/)
+{
+    ++_allocations;
+
+    int index = classIndex(numbytes);
+    unsigned char* raw = nullptr;
+    if (index < 0)
+    {
+        ++_oversized;
+        raw = (unsigned char*)malloc(numbytes + RTP_POOL_HEADER_SIZE);
+        if (!raw)
+        {
+            return nullptr;
+        }
+        *(uint32_t*)raw = RTP_POOL_OVERSIZED;
+        _bytes_in_use += numbytes;
+        *(uint64_t*)(raw + 8) = numbytes;
+        return raw + RTP_POOL_HEADER_SIZE;
+    }
+
+    SizeClass& size_class = _classes[index];
+    {
+        std::lock_guard<std::mutex> lg(size_class.locker);
+        if (size_class.free)
+        {
+            Block* block = size_class.free;
+            size_class.free = block->next;
+            --size_class.retained;
+            raw = (unsigned char*)block - RTP_POOL_HEADER_SIZE;
+        }
+    }
+
+    if (raw)
+    {
+        ++_pool_hits;
+        _bytes_retained -= classSize(index);
+    }
+    else
+    {
+        ++_pool_misses;
+        raw = (unsigned char*)malloc(classSize(index) + RTP_POOL_HEADER_SIZE);
+        if (!raw)
+        {
+            return nullptr;
+        }
+        *(uint32_t*)raw = (uint32_t)index;
+    }
+
+    _bytes_in_use += classSize(index);
+    return raw + RTP_POOL_HEADER_SIZE;
+}
+
+void RtpMemoryPool::FreeBuffer(void *buffer)
+{
+    if (!buffer)
+    {
+        return;
+    }
+    ++_frees;
+
+    unsigned char* raw = (unsigned char*)buffer - RTP_POOL_HEADER_SIZE;
+    uint32_t index = *(uint32_t*)raw;
+    if (RTP_POOL_OVERSIZED == index)
+    {
+        _bytes_in_use -= *(uint64_t*)(raw + 8);
+        free(raw);
+        return;
+    }
+
+    _bytes_in_use -= classSize((int)index);
+
+    SizeClass& size_class = _classes[index];
+    {
+        std::lock_guard<std::mutex> lg(size_class.locker);
+        if (size_class.retained < RTP_POOL_MAX_RETAINED)
+        {
+            Block* block = (Block*)buffer;
+            block->next = size_class.free;
+            size_class.free = block;
+            ++size_class.retained;
+            raw = nullptr;
+        }
+    }
+
+    if (raw)
+    {
+        free(raw);
+    }
+    else
+    {
+        _bytes_retained += classSize((int)index);
+    }
+}
+
+RtpMemoryPool::Statistics RtpMemoryPool::GetStatistics() const
+{
+    Statistics statistics;
+    statistics.allocations = _allocations;
+    statistics.frees = _frees;
+    statistics.pool_hits = _pool_hits;
+    statistics.pool_misses = _pool_misses;
+    statistics.oversized = _oversized;
+    statistics.bytes_in_use = _bytes_in_use;
+    statistics.bytes_retained = _bytes_retained;
+    return statistics;
+}
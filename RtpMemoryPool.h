@@ -0,0 +1,86 @@
+
+/*****************************************************************************
+*                                                                            *
+*  @file     RtpMemoryPool.h                                                 *
+*  @brief    Size-classed jrtplib memory manager declaration                 *
+*                                                                            *
+*  Details.                                                                  *
+*    Installed per RtpClient session through jrtplib's RTPMemoryManager      *
+*    hook, so RTPPacket objects and their buffers are recycled instead of    *
+*    going through malloc/free for every received packet.                    *
+*                                                                            *
+*----------------------------------------------------------------------------*
+*  Remark   :                                                                *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef __RTP_MEMORY_POOL_HEADER_H__
+#define __RTP_MEMORY_POOL_HEADER_H__
+
+#include "jrtplib3/rtpmemorymanager.h"
+
+#include <atomic>
+#include <mutex>
+
+#include <stddef.h>
+
+// classes are 64, 128, ..., 8192 bytes; bigger requests go straight to malloc
+#define RTP_POOL_MIN_CLASS_SHIFT    6
+#define RTP_POOL_CLASS_COUNT        8
+
+// free blocks a class keeps for reuse, the rest is given back to the heap
+#define RTP_POOL_MAX_RETAINED       1024
+
+class RtpMemoryPool : public jrtplib::RTPMemoryManager
+{
+public:
+    struct Statistics
+    {
+        unsigned long long allocations = 0;
+        unsigned long long frees = 0;
+        unsigned long long pool_hits = 0;      // served from a free list
+        unsigned long long pool_misses = 0;    // a new block had to be allocated
+        unsigned long long oversized = 0;      // larger than the biggest class
+        unsigned long long bytes_in_use = 0;
+        unsigned long long bytes_retained = 0; // idle in the free lists
+    };
+
+public:
+    RtpMemoryPool();
+    ~RtpMemoryPool();
+
+    void *AllocateBuffer(size_t numbytes, int memtype);
+    void FreeBuffer(void *buffer);
+
+    Statistics GetStatistics() const;
+
+private:
+    struct Block
+    {
+        Block* next;
+    };
+
+    struct SizeClass
+    {
+        std::mutex locker;
+        Block* free = nullptr;
+        size_t retained = 0;
+    };
+
+    SizeClass _classes[RTP_POOL_CLASS_COUNT];
+
+private:
+    std::atomic<unsigned long long> _allocations;
+    std::atomic<unsigned long long> _frees;
+    std::atomic<unsigned long long> _pool_hits;
+    std::atomic<unsigned long long> _pool_misses;
+    std::atomic<unsigned long long> _oversized;
+    std::atomic<unsigned long long> _bytes_in_use;
+    std::atomic<unsigned long long> _bytes_retained;
+
+private:
+    RtpMemoryPool(const RtpMemoryPool& rhs);
+    RtpMemoryPool& operator=(const RtpMemoryPool& rhs);
+};
+
+#endif
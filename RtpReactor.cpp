@@ -0,0 +1,221 @@
+
+#include "RtpReactor.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <errno.h>
+
+#define RTP_REACTOR_MAX_EVENTS      64
+
+// idle sessions get an OnReactorEvent at least this often, jrtplib needs it for RTCP
+#define RTP_REACTOR_TICK_MS         1000
+
+RtpReactor::RtpReactor()
+    : _running(false), _workers()
+    , _locker(), _sessions()
+{
+}
+
+RtpReactor::~RtpReactor()
+{
+    Destroy();
+}
+
+int RtpReactor::Create(int threads)
+{
+    std::lock_guard<std::mutex> lg(_locker);
+    if (_running)
+    {
+        return 0;
+    }
+
+    if (threads <= 0)
+    {
+        threads = (int)std::thread::hardware_concurrency();
+        if (threads <= 0)
+        {
+            threads = 1;
+        }
+    }
+
+    for (int i = 0; i < threads; ++i)
+    {
+        Worker* worker = new Worker();
+        if (worker->poller.Create() < 0)
+        {
+            delete worker;
+            break;
+        }
+        _workers.push_back(worker);
+    }
+
+    if (_workers.size() < (size_t)threads)
+    {
+        for (Worker* worker : _workers)
+        {
+            delete worker;
+        }
+        _workers.clear();
+        return -1;
+    }
+
+    _running = true;
+    for (Worker* worker : _workers)
+    {
+        worker->thread = std::thread(&RtpReactor::Run, this, worker);
+    }
+    return 0;
+}
+
+void RtpReactor::Destroy()
+{
+    // stop under the lock so a concurrent Register never picks a worker that is going away
+    std::vector<Worker*> workers;
+    {
+        std::lock_guard<std::mutex> lg(_locker);
+        if (!_running.exchange(false))
+        {
+            return;
+        }
+        workers.swap(_workers);
+    }
+
+    for (Worker* worker : workers)
+    {
+        worker->poller.Wakeup();
+    }
+    for (Worker* worker : workers)
+    {
+        if (worker->thread.joinable())
+        {
+            worker->thread.join();
+        }
+    }
+
+    // an Unregister may still be using a worker until it gives up _locker
+    std::lock_guard<std::mutex> lg(_locker);
+    for (std::map<Session*, Worker*>::iterator it = _sessions.begin(); it != _sessions.end();)
+    {
+        if (std::find(workers.begin(), workers.end(), it->second) != workers.end())
+        {
+            it = _sessions.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    for (Worker* worker : workers)
+    {
+        delete worker;
+    }
+}
+
+int RtpReactor::Register(Session* session, const SOCKET* fds, int count)
+{
+    std::lock_guard<std::mutex> lg(_locker);
+    if (!_running || _workers.empty() || _sessions.count(session) > 0)
+    {
+        return -1;
+    }
+
+    Worker* worker = _workers[0];
+    for (Worker* candidate : _workers)
+    {
+        if (candidate->load < worker->load)
+        {
+            worker = candidate;
+        }
+    }
+
+    std::lock_guard<std::mutex> wlg(worker->locker);
+    std::vector<SOCKET>& watched = worker->sessions[session];
+    for (int i = 0; i < count; ++i)
+    {
+        if (worker->poller.Add(fds[i], session) < 0)
+        {
+            for (SOCKET fd : watched)
+            {
+                worker->poller.Remove(fd);
+            }
+            worker->sessions.erase(session);
+            return -1;
+        }
+        watched.push_back(fds[i]);
+    }
+
+    ++worker->load;
+    _sessions[session] = worker;
+    return 0;
+}
+
+void RtpReactor::Unregister(Session* session)
+{
+    std::lock_guard<std::mutex> lg(_locker);
+    std::map<Session*, Worker*>::iterator it = _sessions.find(session);
+    if (it == _sessions.end())
+    {
+        return;
+    }
+
+    Worker* worker = it->second;
+    _sessions.erase(it);
+
+    std::lock_guard<std::mutex> wlg(worker->locker);
+    std::map<Session*, std::vector<SOCKET>>::iterator wit = worker->sessions.find(session);
+    if (wit != worker->sessions.end())
+    {
+        for (SOCKET fd : wit->second)
+        {
+            worker->poller.Remove(fd);
+        }
+        worker->sessions.erase(wit);
+    }
+    --worker->load;
+}
+
+void RtpReactor::Run(Worker* worker)
+{
+    void* ready[RTP_REACTOR_MAX_EVENTS];
+    std::chrono::steady_clock::time_point last_tick = std::chrono::steady_clock::now();
+    while (_running)
+    {
+        int count = worker->poller.Wait(ready, RTP_REACTOR_MAX_EVENTS, RTP_REACTOR_TICK_MS);
+        if (count < 0)
+        {
+            LOG_ERROR("reactor", "reactor wait error: %d", errno);
+            count = 0;
+        }
+
+        std::lock_guard<std::mutex> lg(worker->locker);
+        for (int i = 0; i < count; ++i)
+        {
+            Session* session = static_cast<Session*>(ready[i]);
+
+            // the RTP and RTCP socket of one session may both be ready, one callback drains both
+            bool duplicated = false;
+            for (int j = 0; j < i && !duplicated; ++j)
+            {
+                duplicated = (ready[j] == ready[i]);
+            }
+
+            // events fetched before an Unregister may still name the removed session
+            if (!duplicated && worker->sessions.count(session) > 0)
+            {
+                session->OnReactorEvent();
+            }
+        }
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - last_tick >= std::chrono::milliseconds(RTP_REACTOR_TICK_MS))
+        {
+            last_tick = now;
+            for (std::map<Session*, std::vector<SOCKET>>::value_type& item : worker->sessions)
+            {
+                item.first->OnReactorEvent();
+            }
+        }
+    }
+}
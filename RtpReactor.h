@@ -0,0 +1,85 @@
+
+/*****************************************************************************
+*                                                                            *
+*  @file     RtpReactor.h                                                    *
+*  @brief    Shared receive thread pool declaration                          *
+*                                                                            *
+*  Details.                                                                  *
+*    A fixed number of threads, each owning one EventPoller, that drive the  *
+*    sockets of many RtpClient sessions. Sessions are spread over the        *
+*    threads by load, so 2000 cameras no longer need 2000 threads.           *
+*                                                                            *
+*----------------------------------------------------------------------------*
+*  Remark   :                                                                *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef __RTP_REACTOR_HEADER_H__
+#define __RTP_REACTOR_HEADER_H__
+
+#include "EventPoller.h"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+
+#include <map>
+#include <vector>
+
+class RtpReactor
+{
+public:
+    class Session
+    {
+    public:
+        virtual ~Session() { }
+
+        /* Called on a reactor thread when one of the session sockets is readable,
+        * and once per tick while idle so the session can run its timers */
+        virtual void OnReactorEvent() = 0;
+    };
+
+public:
+    RtpReactor();
+    ~RtpReactor();
+
+    /* threads: number of reactor threads, 0 = one per hardware thread */
+    int Create(int threads = 0);
+    void Destroy();
+
+    /* Attach the session sockets to the least loaded reactor thread */
+    int Register(Session* session, const SOCKET* fds, int count);
+
+    /* Detach the session, OnReactorEvent is never called for it once this returns.
+    * Must not be called from inside OnReactorEvent */
+    void Unregister(Session* session);
+
+    int GetThreadCount() const { return (int)_workers.size(); }
+
+private:
+    struct Worker
+    {
+        EventPoller poller;
+        std::thread thread;
+        std::mutex locker;  // held while dispatching, so Unregister waits for a running callback
+        std::map<Session*, std::vector<SOCKET>> sessions;
+        std::atomic<int> load;
+
+        Worker() : poller(), thread(), locker(), sessions(), load(0) { }
+    };
+
+    void Run(Worker* worker);
+
+private:
+    std::atomic<bool> _running;
+    std::vector<Worker*> _workers;
+
+    std::mutex _locker;
+    std::map<Session*, Worker*> _sessions;
+
+private:
+    RtpReactor(const RtpReactor& rhs);
+    RtpReactor& operator=(const RtpReactor& rhs);
+};
+
+#endif
@@ -0,0 +1,259 @@
+
+#include "RtpStatistics.h"
+
+/* RFC3550.A.1 */
+#define RTP_SEQ_MOD         (1 << 16)
+#define RTP_MAX_DROPOUT     3000
+#define RTP_MAX_MISORDER    100
+
+RtpStatisticsCollector::RtpStatisticsCollector()
+    : _clock_rate(0), _started(false), _max_sequence(0), _cycles(0), _base_sequence(0), _bad_sequence(RTP_SEQ_MOD + 1), _seen()
+    , _transit_valid(false), _transit(0), _jitter_value(0.0), _epoch()
+    , _received(0), _interval_start(TimePoint()), _expected_prior(0), _received_prior(0), _bytes_prior(0)
+    , _packets_received(0), _bytes_received(0), _expected(0), _cumulative_lost(0)
+    , _interval_lost(0), _interval_expected(0), _interval_bitrate(0), _jitter(0)
+    , _out_of_order(0), _duplicated(0), _queue_high_water(0), _packets_dropped(0), _bytes_dropped(0)
+    , _published_clock_rate(0)
+{
+}
+
+RtpStatisticsCollector::~RtpStatisticsCollector()
+{
+}
+
+void RtpStatisticsCollector::Reset(int clock_rate)
+{
+    _clock_rate = clock_rate;
+    _started = false;
+    _bad_sequence = RTP_SEQ_MOD + 1;
+    _transit_valid = false;
+    _jitter_value = 0.0;
+
+    _received = 0;
+    _interval_start = TimePoint();
+    _expected_prior = 0;
+    _received_prior = 0;
+    _bytes_prior = 0;
+
+    _packets_received = 0;
+    _bytes_received = 0;
+    _expected = 0;
+    _cumulative_lost = 0;
+    _interval_lost = 0;
+    _interval_expected = 0;
+    _interval_bitrate = 0;
+    _jitter = 0;
+    _out_of_order = 0;
+    _duplicated = 0;
+    _queue_high_water = 0;
+    _packets_dropped = 0;
+    _bytes_dropped = 0;
+    _published_clock_rate = clock_rate;
+}
+
+void RtpStatisticsCollector::initSequence(uint16_t sequence)
+{
+    _max_sequence = sequence;
+    _cycles = 0;
+    _base_sequence = sequence;
+    _bad_sequence = RTP_SEQ_MOD + 1;
+    _seen.reset();
+    _seen.set(sequence % _seen.size());
+
+    _received = 0;
+    _expected_prior = 0;
+    _received_prior = 0;
+}
+
+void RtpStatisticsCollector::OnPacket(uint16_t sequence, uint32_t timestamp, size_t bytes, const TimePoint& now)
+{
+    ++_packets_received;
+    _bytes_received += bytes;
+
+    if (!_started)
+    {
+        _started = true;
+        _epoch = now;
+        _interval_start = now;
+        _bytes_prior = 0;
+        initSequence(sequence);
+    }
+    else
+    {
+        uint16_t delta = (uint16_t)(sequence - _max_sequence);
+        if (delta == 0)
+        {
+            ++_duplicated;
+        }
+        else if (delta < RTP_MAX_DROPOUT)
+        {
+            // in order, with a permissible gap
+            for (uint16_t s = _max_sequence + 1; s != sequence && (uint16_t)(s - _max_sequence) < _seen.size(); ++s)
+            {
+                _seen.reset(s % _seen.size());
+            }
+            _seen.set(sequence % _seen.size());
+
+            if (sequence < _max_sequence)
+            {
+                _cycles += RTP_SEQ_MOD;
+            }
+            _max_sequence = sequence;
+        }
+        else if (delta <= RTP_SEQ_MOD - RTP_MAX_MISORDER)
+        {
+            // a very large jump, two sequential packets in a row mean the source restarted
+            if (sequence == _bad_sequence)
+            {
+                initSequence(sequence);
+            }
+            else
+            {
+                _bad_sequence = (uint32_t)((sequence + 1) & (RTP_SEQ_MOD - 1));
+                return;
+            }
+        }
+        else
+        {
+            // behind _max_sequence: a duplicate or a reordered packet
+            if ((uint16_t)(_max_sequence - sequence) < _seen.size() && _seen.test(sequence % _seen.size()))
+            {
+                ++_duplicated;
+            }
+            else
+            {
+                ++_out_of_order;
+                if ((uint16_t)(_max_sequence - sequence) < _seen.size())
+                {
+                    _seen.set(sequence % _seen.size());
+                }
+            }
+        }
+    }
+    ++_received;
+    unsigned long long expected = (unsigned long long)_cycles + _max_sequence - _base_sequence + 1;
+    _expected = expected;
+    _cumulative_lost = (long long)expected - (long long)_received;
+
+    /* RFC3550.A.8, arrival time in timestamp units */
+    if (_clock_rate > 0)
+    {
+        int64_t arrival = std::chrono::duration_cast<std::chrono::microseconds>(now - _epoch).count() * _clock_rate / 1000000;
+        int64_t transit = (int64_t)(uint32_t)(arrival - timestamp);
+        if (_transit_valid)
+        {
+            int32_t d = (int32_t)(uint32_t)(transit - _transit);
+            if (d < 0)
+            {
+                d = -d;
+            }
+            _jitter_value += (1.0 / 16.0) * ((double)d - _jitter_value);
+            _jitter = (uint32_t)_jitter_value;
+        }
+        _transit = transit;
+        _transit_valid = true;
+    }
+
+    if (now - _interval_start.load() >= std::chrono::milliseconds(RTP_STATISTICS_INTERVAL_MS))
+    {
+        closeInterval(now);
+    }
+}
+
+void RtpStatisticsCollector::closeInterval(const TimePoint& now)
+{
+    unsigned long long expected_interval = 0;
+    long long lost_interval = 0;
+    unsigned long long bitrate = 0;
+    measureInterval(now, expected_interval, lost_interval, bitrate);
+    _interval_expected = expected_interval;
+    _interval_lost = lost_interval;
+    _interval_bitrate = bitrate;
+
+    // the start goes last, Get takes a changed start for an interval closed under it
+    _expected_prior = _expected.load();
+    _received_prior = _received.load();
+    _bytes_prior = _bytes_received.load();
+    _interval_start = now;
+}
+
+void RtpStatisticsCollector::measureInterval(const TimePoint& now, unsigned long long& expected, long long& lost, unsigned long long& bitrate) const
+{
+    /* RFC3550.A.3 */
+    expected = _expected - _expected_prior;
+    lost = (long long)expected - (long long)(_received - _received_prior);
+
+    long long elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(now - _interval_start.load()).count();
+    bitrate = (elapsed_us > 0) ? (_bytes_received - _bytes_prior) * 8 * 1000000 / (unsigned long long)elapsed_us : 0;
+}
+
+void RtpStatisticsCollector::OnQueued(size_t depth)
+{
+    if (depth > _queue_high_water.load(std::memory_order_relaxed))
+    {
+        _queue_high_water.store(depth, std::memory_order_relaxed);
+    }
+}
+
+void RtpStatisticsCollector::OnDropped(size_t bytes)
+{
+    ++_packets_dropped;
+    _bytes_dropped += bytes;
+}
+
+RtpStatistics RtpStatisticsCollector::Get() const
+{
+    RtpStatistics statistics;
+    statistics.packets_received = _packets_received;
+    statistics.bytes_received = _bytes_received;
+    statistics.expected = _expected;
+    statistics.cumulative_lost = _cumulative_lost;
+
+    statistics.interval_lost = _interval_lost;
+    unsigned long long interval_expected = _interval_expected;
+    statistics.interval_bitrate = _interval_bitrate;
+
+    // the stream stalled, no packet arrived to close the interval that ran out
+    TimePoint now = std::chrono::steady_clock::now();
+    TimePoint interval_start = _interval_start;
+    std::chrono::milliseconds interval(RTP_STATISTICS_INTERVAL_MS);
+    if (now - interval_start >= 2 * interval)
+    {
+        // a whole interval went by without a packet
+        statistics.interval_lost = 0;
+        interval_expected = 0;
+        statistics.interval_bitrate = 0;
+    }
+    else if (now - interval_start >= interval)
+    {
+        unsigned long long expected = 0;
+        long long lost = 0;
+        unsigned long long bitrate = 0;
+        measureInterval(now, expected, lost, bitrate);
+        if (_interval_start.load() == interval_start)
+        {
+            statistics.interval_lost = lost;
+            interval_expected = expected;
+            statistics.interval_bitrate = bitrate;
+        }
+    }
+
+    if (interval_expected > 0 && statistics.interval_lost > 0)
+    {
+        statistics.interval_fraction_lost = (double)statistics.interval_lost / (double)interval_expected;
+    }
+
+    statistics.jitter = _jitter;
+    int clock_rate = _published_clock_rate;
+    if (clock_rate > 0)
+    {
+        statistics.jitter_ms = (double)statistics.jitter * 1000.0 / (double)clock_rate;
+    }
+
+    statistics.out_of_order = _out_of_order;
+    statistics.duplicated = _duplicated;
+    statistics.queue_high_water = _queue_high_water;
+    statistics.packets_dropped = _packets_dropped;
+    statistics.bytes_dropped = _bytes_dropped;
+    return statistics;
+}
@@ -0,0 +1,123 @@
+
+/*****************************************************************************
+*                                                                            *
+*  @file     RtpStatistics.h                                                 *
+*  @brief    Per-stream RTP receive statistics declaration                   *
+*                                                                            *
+*  Details.                                                                  *
+*    Updated by the receive thread only, every counter is an atomic so       *
+*    Get() may be called from any thread without a lock. Loss and jitter     *
+*    follow RFC3550 appendix A.1, A.3 and A.8.                               *
+*                                                                            *
+*----------------------------------------------------------------------------*
+*  Remark   :                                                                *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef __RTP_STATISTICS_HEADER_H__
+#define __RTP_STATISTICS_HEADER_H__
+
+#include <atomic>
+#include <bitset>
+#include <chrono>
+
+#include <stddef.h>
+#include <stdint.h>
+
+// length of the interval loss and bitrate window
+#define RTP_STATISTICS_INTERVAL_MS  1000
+
+struct RtpStatistics
+{
+    unsigned long long packets_received = 0;    // duplicates included, as in RFC3550
+    unsigned long long bytes_received = 0;      // whole packets, RTP header included
+
+    long long cumulative_lost = 0;              // expected - received, negative with duplicates
+    unsigned long long expected = 0;            // since the first packet or the last sequence restart
+    long long interval_lost = 0;                // over the last complete interval
+    double interval_fraction_lost = 0.0;        // 0.0 - 1.0
+    unsigned long long interval_bitrate = 0;    // bits per second over the last complete interval
+
+    uint32_t jitter = 0;                        // RFC3550.A.8, in RTP timestamp units
+    double jitter_ms = 0.0;
+
+    unsigned long long out_of_order = 0;
+    unsigned long long duplicated = 0;
+
+    size_t queue_high_water = 0;                // packets
+    unsigned long long packets_dropped = 0;     // queue overflow, late and duplicated packets
+    unsigned long long bytes_dropped = 0;
+    long long kernel_dropped = -1;              // socket receive queue overflow, -1 if unknown (see RtpClient::GetKernelDropCount)
+};
+
+class RtpStatisticsCollector
+{
+public:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+
+public:
+    RtpStatisticsCollector();
+    ~RtpStatisticsCollector();
+
+    /* Start over for a new session, clock_rate is the RTP timestamp frequency */
+    void Reset(int clock_rate);
+
+    /* producer side */
+    void OnPacket(uint16_t sequence, uint32_t timestamp, size_t bytes, const TimePoint& now);
+    void OnQueued(size_t depth);
+    void OnDropped(size_t bytes);
+
+    /* safe from any thread */
+    RtpStatistics Get() const;
+
+private:
+    void initSequence(uint16_t sequence);
+    void closeInterval(const TimePoint& now);
+
+    /* Loss and bitrate of the interval running since _interval_start, as it stands at 'now' */
+    void measureInterval(const TimePoint& now, unsigned long long& expected, long long& lost, unsigned long long& bitrate) const;
+
+private:
+    // producer side only
+    int _clock_rate;
+    bool _started;
+    uint16_t _max_sequence;
+    uint32_t _cycles;
+    uint32_t _base_sequence;
+    uint32_t _bad_sequence;
+    std::bitset<1024> _seen;        // sequence numbers just behind _max_sequence
+
+    bool _transit_valid;
+    int64_t _transit;
+    double _jitter_value;
+    TimePoint _epoch;
+
+private:
+    // written by the producer, Get reads them to close an interval no packet came to close
+    std::atomic<unsigned long long> _received;      // since the last sequence restart
+    std::atomic<TimePoint> _interval_start;
+    std::atomic<unsigned long long> _expected_prior;
+    std::atomic<unsigned long long> _received_prior;
+    std::atomic<unsigned long long> _bytes_prior;
+
+    std::atomic<unsigned long long> _packets_received;
+    std::atomic<unsigned long long> _bytes_received;
+    std::atomic<unsigned long long> _expected;
+    std::atomic<long long> _cumulative_lost;
+    std::atomic<long long> _interval_lost;
+    std::atomic<unsigned long long> _interval_expected;
+    std::atomic<unsigned long long> _interval_bitrate;
+    std::atomic<uint32_t> _jitter;
+    std::atomic<unsigned long long> _out_of_order;
+    std::atomic<unsigned long long> _duplicated;
+    std::atomic<size_t> _queue_high_water;
+    std::atomic<unsigned long long> _packets_dropped;
+    std::atomic<unsigned long long> _bytes_dropped;
+    std::atomic<int> _published_clock_rate;
+
+private:
+    RtpStatisticsCollector(const RtpStatisticsCollector& rhs);
+    RtpStatisticsCollector& operator=(const RtpStatisticsCollector& rhs);
+};
+
+#endif
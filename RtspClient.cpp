@@ -16,11 +16,15 @@
 #include "RtspClient.h"
 
 #include "utils.h"
+#include "Logger.h"
+#include "MulticastGroup.h"
+#include "RtspResponse.h"
 #include "Base64.hh"
 
 #include <sstream>
 #include <iostream>
 #include <string>
+#include <chrono>
 
 #include <regex>
 
@@ -31,19 +35,30 @@
 #include <sys/socket.h>
 #include <strings.h>
 #include <unistd.h>
+#include <poll.h>
 #endif
 #include <stdlib.h>
 #include <stdio.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <limits.h>
 
 
 #define PORT_RTSP                554
 #define VERSION_RTSP             "1.0"
 #define VERSION_HTTP             "1.1"
 
-#define RECV_BUF_SIZE            (1 << 12)
+#define RECV_BUF_SIZE            (1 << 14) // one read usually takes a whole reply, SDP included
 #define SEARCH_PORT_RTP_FROM     5000 // '5000' is chosen at random(must be a even number)
+#define CONNECT_TIMEOUT_MS       5000  // default deadlines, see SetTimeouts
+#define SEND_TIMEOUT_MS          5000
+#define RECV_HEADER_TIMEOUT_MS   10000
+#define RECV_BODY_TIMEOUT_MS     10000
+#define RECV_MAX_MESSAGE         (1 << 20) // a reply growing beyond this without ending is garbage
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL             0
+#endif
 
 const char* const HTTP_HEAD_ACCEPT          = "Accept: ";
 const char* const HTTP_HEAD_USER_AGENT      = "User-Agent: ";
@@ -71,6 +86,46 @@ const char* const HTTP_HEAD_USER_AGENT_TUNNEL = "User-Agent: %s\r\nx-sessioncook
 
 #define Close_Socket(fd) if(fd != INVALID_SOCKET) { closesocket(fd); fd = INVALID_SOCKET; }
 
+// the constant parts of every request, sent from here as they are
+static const std::string s_request_version = " RTSP/" VERSION_RTSP "\r\nCSeq: ";
+static const std::string s_request_user_agent = std::string("\r\n") + HTTP_HEAD_USER_AGENT + HTTP_HEAD_VALUE_USER_AGENT + "\r\n";
+static const std::string s_request_accept_sdp = std::string(HTTP_HEAD_ACCEPT) + "application/sdp\r\n";
+
+typedef std::chrono::steady_clock::time_point Deadline;
+
+/* 'ms' from now, never for a negative 'ms' */
+static Deadline deadlineIn(int ms)
+{
+    return (ms < 0) ? Deadline::max() : std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+}
+
+/* Milliseconds left until 'deadline', -1 for never */
+static int msLeft(const Deadline& deadline)
+{
+    if (Deadline::max() == deadline)
+    {
+        return -1;
+    }
+    std::chrono::steady_clock::duration left = deadline - std::chrono::steady_clock::now();
+    if (left <= std::chrono::steady_clock::duration::zero())
+    {
+        return 0;
+    }
+    // round up, a wait ending a little early would only poll once more
+    return (int)std::chrono::duration_cast<std::chrono::milliseconds>(left + std::chrono::milliseconds(1) - std::chrono::nanoseconds(1)).count();
+}
+
+static int setNonBlocking(SOCKET fd)
+{
+#ifdef _MSC_VER
+    u_long mode = 1;
+    return ioctlsocket(fd, FIONBIO, &mode);
+#else
+    int flags = fcntl(fd, F_GETFL, 0);
+    return (flags < 0) ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+#endif
+}
+
 
 bool RtspClient::checkRtspUri(const std::string& uri)
 {
@@ -80,16 +135,16 @@ bool RtspClient::checkRtspUri(const std::string& uri)
     bool res = true;
     do 
     {
-        std::smatch matchs;
-        if (std::regex_match(uri, matchs, rtsp_with_user_password))
-        {
-            _username = matchs[2].str();
-            _password = matchs[3].str();
-            _uri_without_user_info = matchs[1].str() + matchs[4].str();
+        std::smatch matchs;
+        if (std::regex_match(uri, matchs, rtsp_with_user_password))
+        {
+            _username = matchs[2].str();
+            _password = matchs[3].str();
+            _uri_without_user_info = matchs[1].str() + matchs[4].str();
         }
-        else if (std::regex_match(uri, matchs, rtsp_without_user_password))
-        {
-            _uri_without_user_info = uri;
+        else if (std::regex_match(uri, matchs, rtsp_without_user_password))
+        {
+            _uri_without_user_info = uri;
         }
         else
         {
@@ -107,18 +162,18 @@ void RtspClient::parseAddressAndPort(const std::string& uri)
 
     std::string domain;
 
-    std::smatch matchs;
-    if (std::regex_match(uri, matchs, rtsp_domain_with_param))
-    {
-        domain = matchs[2].str();
+    std::smatch matchs;
+    if (std::regex_match(uri, matchs, rtsp_domain_with_param))
+    {
+        domain = matchs[2].str();
     }
-    else if (std::regex_match(uri, matchs, rtsp_domain_without_param))
-    {
-        domain = matchs[2].str();
+    else if (std::regex_match(uri, matchs, rtsp_domain_without_param))
+    {
+        domain = matchs[2].str();
     }
     else
     {
-        std::cerr << "parse address and port error: " << uri << std::endl;
+        LOG_ERROR(_log_tag.c_str(), "parse address and port error: %s", uri.c_str());
     }
 
     std::string::size_type pos = domain.find(':');
@@ -135,9 +190,21 @@ void RtspClient::parseAddressAndPort(const std::string& uri)
 
 ErrorType RtspClient::connectToRtspServer()
 {
+    // a reconnect leaves nothing of the previous connection behind, the demuxer reading it included
+    _demuxer.Stop();
+    Close_Socket(_rtsp_socket);
+    _recv_buffer.clear();
+
     _rtsp_socket = socket(AF_INET, SOCK_STREAM, 0);
     Check_Socket_Return(_rtsp_socket);
 
+    // non-blocking from here on, every wait for the server is a poll bounded by the timeouts
+    if (setNonBlocking(_rtsp_socket) < 0)
+    {
+        Close_Socket(_rtsp_socket);
+        return RTSP_SOCKET_INIT;
+    }
+
     struct sockaddr_in serv_addr;
     // Connect to server
     memset(&serv_addr, 0, sizeof(serv_addr));
@@ -145,60 +212,86 @@ ErrorType RtspClient::connectToRtspServer()
     serv_addr.sin_port = htons(_port);
     serv_addr.sin_addr.s_addr = inet_addr(_address.c_str());
 
-    if (connect(_rtsp_socket, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0 && errno != EINPROGRESS)
+    if (connect(_rtsp_socket, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0)
     {
-        Close_Socket(_rtsp_socket);
-        return RTSP_SOCKET_CONNECT;
+        if (!LastSocketErrorWouldBlock())
+        {
+            Close_Socket(_rtsp_socket);
+            return RTSP_SOCKET_CONNECT;
+        }
+
+        // the outcome of a non-blocking connect is reported once the socket turns writable
+        int error = 0;
+        socklen_t length = sizeof(error);
+        ErrorType res = checkSockWritable(_rtsp_socket, _connect_timeout_ms);
+        if (RTSP_NO_ERROR == res)
+        {
+            if (getsockopt(_rtsp_socket, SOL_SOCKET, SO_ERROR, (char*)&error, &length) < 0)
+            {
+                error = LastSocketError();
+                res = RTSP_SOCKET_CONNECT;
+            }
+            else if (error != 0)
+            {
+                res = RTSP_SOCKET_CONNECT;
+            }
+        }
+        else if (RTSP_TIMEOUT != res)
+        {
+            // the poll itself failed
+            error = LastSocketError();
+        }
+
+        if (RTSP_TIMEOUT == res)
+        {
+            LOG_ERROR(_log_tag.c_str(), "connect %s:%u timed out", _address.c_str(), _port);
+        }
+        else if (RTSP_NO_ERROR != res)
+        {
+            LOG_ERROR(_log_tag.c_str(), "connect %s:%u error: %d", _address.c_str(), _port, error);
+        }
+        if (RTSP_NO_ERROR != res)
+        {
+            Close_Socket(_rtsp_socket);
+            return res;
+        }
     }
     return RTSP_NO_ERROR;
 }
 
-ErrorType RtspClient::checkSockWritable(SOCKET sockfd, struct timeval * tval)
+ErrorType RtspClient::checkSockWritable(SOCKET sockfd, int timeout_ms)
 {
-    // fd_set Wset;
-    // struct timeval Tval;
-    // FD_ZERO(&Wset);
-    // FD_SET(sockfd, &Wset);
-    // if(!tval) {
-    //     Tval.tv_sec = SELECT_TIMEOUT_SEC;
-    //     Tval.tv_usec = SELECT_TIMEOUT_USEC;
-    // } else {
-    //     Tval = *tval;
-    // }
+    return waitSocket(sockfd, POLLOUT, timeout_ms);
+}
 
-    // while(select(sockfd + 1, NULL, &Wset, NULL, &Tval) != 0) {
-    //     if(FD_ISSET(sockfd, &Wset)) {
-    //         return CHECK_OK;
-    //     }
-    //     return CHECK_ERROR;
-    // }   
-    // printf("Select Timeout\n");
-    // return CHECK_ERROR;
-    return RTSP_NO_ERROR;
+ErrorType RtspClient::checkSockReadable(SOCKET sockfd, int timeout_ms)
+{
+    return waitSocket(sockfd, POLLIN, timeout_ms);
 }
 
-ErrorType RtspClient::checkSockReadable(SOCKET sockfd, struct timeval * tval)
+ErrorType RtspClient::waitSocket(SOCKET sockfd, short events, int timeout_ms)
 {
-    // fd_set Rset;
-    // struct timeval Tval;
-    // FD_ZERO(&Rset);
-    // FD_SET(sockfd, &Rset);
-    // if(!tval) {
-    //     Tval.tv_sec = SELECT_TIMEOUT_SEC;
-    //     Tval.tv_usec = SELECT_TIMEOUT_USEC;
-    // } else {
-    //     Tval = *tval;
-    // }
+    struct pollfd pfd;
+    pfd.fd = sockfd;
+    pfd.events = events;
+    pfd.revents = 0;
 
-    // while(select(sockfd + 1, &Rset, NULL, NULL, &Tval) != 0) {
-    //     if(FD_ISSET(sockfd, &Rset)) {
-    //         return CHECK_OK;
-    //     }
-    //     return CHECK_ERROR;
-    // }   
-    // printf("Select Timeout\n");
-    // return CHECK_ERROR;
-    return RTSP_NO_ERROR;
+    int res = 0;
+    do
+    {
+#ifdef _MSC_VER
+        res = WSAPoll(&pfd, 1, timeout_ms);
+#else
+        res = poll(&pfd, 1, timeout_ms);
+#endif
+    } while (res < 0 && LastSocketErrorInterrupted());
+
+    if (res == 0)
+    {
+        return RTSP_TIMEOUT;
+    }
+    // an error or hangup is ready as well, the next read or write reports it
+    return (res > 0) ? RTSP_NO_ERROR : RTSP_SOCKET_INIT;
 }
 
 ErrorType RtspClient::sendRTSP(SOCKET fd, const std::string& msg)
@@ -209,17 +302,17 @@ ErrorType RtspClient::sendRTSP(SOCKET fd, const std::string& msg)
 
     int size = (int)msg.size();
     char* data = (char*)msg.data();
+    Deadline deadline = deadlineIn(_send_timeout_ms);
     while (Index < size) {
-        if (RTSP_NO_ERROR != checkSockWritable(fd))
+        if (RTSP_NO_ERROR != (Err = checkSockWritable(fd, msLeft(deadline))))
         {
-            Err = RTSP_SEND_ERROR;
             break;
         }
-        SendResult = Writen(fd, data + Index, size);
+        SendResult = Writen(fd, data + Index, size - Index);
         if (SendResult < 0)
         {
-            if (errno == EINTR) continue;
-            else if (errno == EWOULDBLOCK || errno == EAGAIN) continue;
+            if (LastSocketErrorInterrupted()) continue;
+            else if (LastSocketErrorWouldBlock()) continue;
             else {
                 Err = RTSP_SEND_ERROR;
                 break;
@@ -236,6 +329,35 @@ ErrorType RtspClient::sendRTSP(SOCKET fd, const std::string& msg)
     return Err;
 }
 
+ErrorType RtspClient::sendRequest()
+{
+    if (_over_http_data_port != 0)
+    {
+        // the tunnel base64-encodes the request as a whole
+        return sendRTSP(_request.ToString());
+    }
+
+    Deadline deadline = deadlineIn(_send_timeout_ms);
+    while (!_request.Sent())
+    {
+        ErrorType ready = checkSockWritable(_rtsp_socket, msLeft(deadline));
+        if (RTSP_NO_ERROR != ready)
+        {
+            return ready;
+        }
+        int res = _request.Send(_rtsp_socket);
+        if (res < 0 && (LastSocketErrorInterrupted() || LastSocketErrorWouldBlock()))
+        {
+            continue;
+        }
+        if (res <= 0)
+        {
+            return RTSP_SEND_ERROR;
+        }
+    }
+    return RTSP_NO_ERROR;
+}
+
 ErrorType RtspClient::sendRTSP(const std::string& msg)
 {
     if (_over_http_data_port != 0) {
@@ -262,52 +384,58 @@ ErrorType RtspClient::sendRTSP(const std::string& msg)
 
 ErrorType RtspClient::recvRTSP(SOCKET fd, std::string& msg)
 {
-    int RecvResult = 0;
-    int Index = 0;
-    ErrorType Err = RTSP_NO_ERROR;
-
-    msg.resize(RECV_BUF_SIZE);
-    char* data = (char*)msg.data();
-    while (Index < RECV_BUF_SIZE)
+    // large reads into the connection buffer, whatever arrives beyond the reply stays there for the next one
+    char data[RECV_BUF_SIZE];
+    int taken = 0;
+    bool body = false;
+    Deadline deadline = deadlineIn(_recv_header_timeout_ms);
+    while ((taken = takeMessage(msg)) == 0)
     {
-        if (RTSP_NO_ERROR != checkSockReadable(fd))
+        // the body gets a deadline of its own once the header block is complete
+        if (!body && RtspResponse::HeaderLength(_recv_buffer) > 0)
         {
-            Err = RTSP_RECV_ERROR;
-            break;
+            body = true;
+            deadline = deadlineIn(_recv_body_timeout_ms);
         }
-        RecvResult = ReadLine(fd, data + Index, RECV_BUF_SIZE);
-        if (RecvResult < 0)
+
+        ErrorType ready = checkSockReadable(fd, msLeft(deadline));
+        if (RTSP_NO_ERROR != ready)
         {
-            if (errno == EINTR) continue;
-            else if (errno == EWOULDBLOCK || errno == EAGAIN)
-            {
-                Err = RTSP_NO_ERROR;
-                break;
-            }
-            else
+            if (RTSP_TIMEOUT == ready)
             {
-                Err = RTSP_RECV_ERROR;
-                break;
+                LOG_ERROR(_log_tag.c_str(), "reply %s timed out", body ? "body" : "headers");
             }
+            return ready;
         }
-        else if (RecvResult == 0)
+
+        int res = (int)recv(fd, data, (int)sizeof(data), 0);
+        if (res > 0)
         {
-            Err = RTSP_RECV_ERROR;
-            break;
+            _recv_buffer.append(data, (size_t)res);
         }
-
-        /*
-        * Single with "\r\n" or "\n" is the termination tag of RTSP.
-        * */
-        if (strcmp(data + Index, "\r\n") == 0 || strcmp(data + Index, "\n") == 0)
+        else if (res < 0 && (LastSocketErrorInterrupted() || LastSocketErrorWouldBlock()))
         {
-            Err = RTSP_NO_ERROR;
-            break;
+            continue;
+        }
+        else
+        {
+            return RTSP_RECV_ERROR;
         }
-        Index += RecvResult;
     }
-    msg.resize(Index);
-    return Err;
+    return (taken > 0) ? RTSP_NO_ERROR : RTSP_RECV_ERROR;
+}
+
+int RtspClient::takeMessage(std::string& msg)
+{
+    size_t length = RtspResponse::MessageLength(_recv_buffer);
+    if (length == 0)
+    {
+        return (_recv_buffer.size() > RECV_MAX_MESSAGE) ? -1 : 0;
+    }
+
+    msg.assign(_recv_buffer, 0, length);
+    _recv_buffer.erase(0, length);
+    return 1;
 }
 
 ErrorType RtspClient::recvRTSP(std::string& msg)
@@ -316,74 +444,121 @@ ErrorType RtspClient::recvRTSP(std::string& msg)
     {
         // to do http tunnel
     }
-    else
+    else if (_demuxer.Running())
     {
-        if (RTSP_NO_ERROR != recvRTSP(_rtsp_socket, msg))
+        // the demuxer owns the socket reads now, the reply comes whole, body included
+        int timeout_ms = (_recv_header_timeout_ms < 0 || _recv_body_timeout_ms < 0) ? INT_MAX : _recv_header_timeout_ms + _recv_body_timeout_ms;
+        if (_demuxer.WaitControl(msg, timeout_ms) < 0)
         {
-            return RTSP_RECV_ERROR;
+            return _demuxer.Closed() ? RTSP_RECV_ERROR : RTSP_TIMEOUT;
         }
     }
+    else
+    {
+        return recvRTSP(_rtsp_socket, msg);
+    }
     return RTSP_NO_ERROR;
 }
 
 ErrorType RtspClient::checkResponse(const std::string& response)
 {
-    static const std::regex response_pattern("RTSP/([0-9]+\\.[0-9]+)(\\s+)([0-9]+)(\\s+)([.|\\S|\\s]*)");
+    RtspResponse parsed;
+    if (parsed.Parse(response) < 0)
+    {
+        return RTSP_RESPONSE_501;
+    }
+    return (ErrorType)parsed.GetStatus();
+}
 
-    int code = 501;
-    std::smatch matchs;
-    if (std::regex_match(response, matchs, response_pattern))
-    {
-        code = atoi(matchs[3].str().c_str());
+ErrorType RtspClient::makeAuth(const std::string& response, const std::string& cmd, const std::string& uri)
+{
+    /* RFC2617 */
+    if (_username.empty())
+    {
+        return RTSP_USER_EMPTY;
+    }
+
+    RtspResponse parsed;
+    RtspResponse::Challenge challenge;
+    if (parsed.Parse(response) < 0 || parsed.GetChallenge(challenge) < 0)
+    {
+        LOG_ERROR(_log_tag.c_str(), "no authentication challenge to answer");
+        return RTSP_RESPONSE_401;
+    }
+
+    _realm.assign(challenge.realm.data(), challenge.realm.size());
+    if (RtspResponse::Challenge::SCHEME_DIGEST == challenge.scheme)
+    {
+        _nonce.assign(challenge.nonce.data(), challenge.nonce.size());
+    }
+    else
+    {
+        _nonce.clear();
     }
 
-    return (ErrorType)code;
+    beginRequest(cmd, _uri);
+    ErrorType res = addAuthorization(cmd, uri);
+    _request.Reference("\r\n");
+    return res;
+}
+
+void RtspClient::beginRequest(const std::string& cmd, const std::string& uri)
+{
+    // <cmd> <uri> RTSP/1.0\r\nCSeq: <n>\r\nUser-Agent: ...\r\n
+    _request.Clear();
+    _request.Append(cmd);
+    _request.Reference(" ");
+    _request.Append(uri);
+    _request.Reference(s_request_version);
+    _request.Append(++_CSeq);
+    _request.Reference(s_request_user_agent);
+}
+
+ErrorType RtspClient::addAuthorization(const std::string& cmd, const std::string& uri)
+{
+    if (_realm.length() > 0 && _nonce.length() > 0)
+    {
+        /* digest auth */
+        std::string Md5Response = makeMd5DigestResp(_realm, cmd, uri, _nonce);
+        if (Md5Response.length() != MD5_SIZE)
+        {
+            LOG_ERROR(_log_tag.c_str(), "Make MD5 digest response error");
+            return RTSP_RESPONSE_401;
+        }
+        _request.Reference("Authorization: Digest username=\"");
+        _request.Append(_username);
+        _request.Reference("\", realm=\"");
+        _request.Append(_realm);
+        _request.Reference("\", nonce=\"");
+        _request.Append(_nonce);
+        _request.Reference("\", uri=\"");
+        _request.Append(uri);
+        _request.Reference("\", response=\"");
+        _request.Append(Md5Response);
+        _request.Reference("\"\r\n");
+    }
+    else if (_realm.length() > 0)
+    {
+        /* basic auth */
+        _request.Reference("Authorization: Basic ");
+        _request.Append(makeBasicResp());
+        _request.Reference("\r\n");
+    }
+    return RTSP_NO_ERROR;
 }
 
 ErrorType RtspClient::doAuth(std::string& response, const std::string& cmd, const std::string& uri)
 {
-    /* RFC2617 */
     ErrorType res = RTSP_NO_ERROR;
     do
     {
-        if (_username.empty())
+        res = makeAuth(response, cmd, uri);
+        if (RTSP_NO_ERROR != res)
         {
-            res = RTSP_USER_EMPTY;
             break;
         }
 
-        static const std::regex digest("WWW-Authenticate: *Digest +realm=\"(.+)\", *nonce=\"([a-zA-Z0-9]+)\"");
-        static const std::regex basic("WWW-Authenticate: *Basic +realm=\"(.+)\"");
-
-        std::stringstream Msg("");
-        Msg << cmd << " " << _uri << " " << "RTSP/" << VERSION_RTSP << "\r\n";
-        Msg << "CSeq: " << ++_CSeq << "\r\n";
-
-        for (std::string::size_type off = 0, pos = response.find("\r\n"); pos != std::string::npos; pos = response.find("\r\n", off))
-        {
-            std::smatch matchs;
-            const std::string& line = response.substr(off, pos - off);
-            if (std::regex_match(line, matchs, digest))
-            {
-                _realm = matchs[1].str();
-                _nonce = matchs[2].str();
-
-                Msg << "Authorization: Digest username=\"" << _username << "\", realm=\""
-                    << _realm << "\", nonce=\"" << _nonce << "\", uri=\"" << uri
-                    << "\", response=\"" << makeMd5DigestResp(_realm, cmd, uri, _nonce) << "\"\r\n";
-                break;
-            }
-            else if (std::regex_match(response, matchs, basic))
-            {
-                _realm = matchs[1].str();
-                Msg << "Authorization: Basic " << makeBasicResp();
-                break;
-            }
-            off = pos + 2;
-        }
-        Msg << "\r\n";
-
-        res = sendRTSP(Msg.str());
+        res = sendRequest();
         if (RTSP_NO_ERROR != res)
         {
             break;
@@ -410,16 +585,17 @@ ErrorType RtspClient::recvSDP(SOCKET sockfd, char* msg, size_t size)
     ErrorType Err = RTSP_NO_ERROR;
 
     memset(msg, 0, size);
+    Deadline deadline = deadlineIn(_recv_body_timeout_ms);
     while (size > 0) {
-        if (RTSP_NO_ERROR != (Err = checkSockReadable(sockfd)))
+        if (RTSP_NO_ERROR != (Err = checkSockReadable(sockfd, msLeft(deadline))))
         {
             break;
         }
         RecvResult = Readn(sockfd, msg + Index, (int)size);
         if (RecvResult < 0) 
         {
-            if (errno == EINTR) continue;
-            else if (errno == EWOULDBLOCK || errno == EAGAIN) 
+            if (LastSocketErrorInterrupted()) continue;
+            else if (LastSocketErrorWouldBlock()) 
             {
                 Err = RTSP_RECV_SDP_ERROR;
                 break;
@@ -444,34 +620,31 @@ ErrorType RtspClient::recvSDP(SOCKET sockfd, char* msg, size_t size)
 
 ErrorType RtspClient::recvSDP(const std::string& response, std::string& msg)
 {
-    static const std::regex length_pattern("Content-Length: +([0-9]+)");
-
-    for (std::string::size_type off = 0, pos = response.find("\r\n"); pos != std::string::npos; pos = response.find("\r\n", off))
-    {
-        std::smatch matchs;
-        const std::string& line = response.substr(off, pos - off);
-
-        if (std::regex_match(line, matchs, length_pattern))
-        {
-            msg.resize(atoi(matchs[1].str().c_str()));
-        }
-        off = pos + 2;
-    }
-
-    if (msg.empty())
+    RtspResponse parsed;
+    long long length = (parsed.Parse(response) == 0) ? parsed.GetContentLength() : -1;
+    if (length <= 0)
     {
-        std::cerr << "unrecognized response: " << response << std::endl;
+        LOG_ERROR(_log_tag.c_str(), "unrecognized response: %s", response.c_str());
         return RTSP_PARSE_SDP_LENGTH_ERROR;
     }
 
-    if (_over_http_data_port != 0)
+    // every reader hands over the reply whole, body included
+    std::string_view body = parsed.GetBody();
+    if (body.size() >= (size_t)length)
     {
-        return recvSDP(_over_http_data_socket, (char*)msg.data(), msg.size());
-    } 
-    else
+        msg.assign(body.data(), (size_t)length);
+        return RTSP_NO_ERROR;
+    }
+    if (_over_http_data_port == 0)
     {
-        return recvSDP(_rtsp_socket, (char*)msg.data(), msg.size());
+        return RTSP_RECV_SDP_ERROR;
     }
+
+    // only the HTTP tunnel still reads the rest of the body here
+    size_t received = body.size();
+    msg.assign(body.data(), received);
+    msg.resize((size_t)length);
+    return recvSDP(_over_http_data_socket, &msg[received], (size_t)length - received);
 }
 
 void RtspClient::parseSDP(const std::string& sdp)
@@ -533,67 +706,89 @@ ErrorType RtspClient::setAvailableRTPPort(uint16_t RTP_port, unsigned short& rtp
     return res;
 }
 
-ErrorType RtspClient::doSETUP(const std::string& media_type, bool rtp_over_tcp)
+ErrorType RtspClient::makeSETUP(const std::string& media_type, bool rtp_over_tcp)
 {
     static const std::string Cmd("SETUP");
 
-    ErrorType res = RTSP_NO_ERROR;
-    do 
-    {
-        std::stringstream Msg("");
+    std::string control_uri = _sdp_info.GetMediaControlUri(media_type, _uri_without_user_info);
+    std::string transport = _sdp_info.GetMediaTransport(media_type);
 
-        std::string control_uri = _sdp_info.GetMediaControlUri(media_type, _uri_without_user_info);
-        std::string transport = _sdp_info.GetMediaTransport(media_type);
-
-        Msg << Cmd << " " << control_uri << " " << "RTSP/" << VERSION_RTSP << "\r\n";
-        if (_over_http_data_port > 0)
+    // every media of the connection gets a channel pair of its own, in SDP order
+    int channel = 0;
+    const SDPData::MediaArray& media_array = _sdp_info.GetMedia();
+    for (size_t i = 0; i < media_array.size(); ++i)
+    {
+        if (media_type == media_array[i].type)
         {
-            Msg << "Transport:" << " " << transport << "/TCP;";
-            Msg << "interleaved=0-1\r\n";
+            channel = (int)i * 2;
+            break;
         }
-        else if (rtp_over_tcp)
+    }
+
+    beginRequest(Cmd, control_uri);
+    _request.Reference("Transport: ");
+    _request.Append(transport);
+    if (_over_http_data_port > 0 || rtp_over_tcp)
+    {
+        _sdp_info.ParseMediaChannels(media_type, channel, channel + 1);
+
+        _request.Reference("/TCP;interleaved=");
+        _request.Append((unsigned int)channel);
+        _request.Reference("-");
+        _request.Append((unsigned int)channel + 1);
+    }
+    else if (_multicast)
+    {
+        // the server picks group and ports, the reply carries them
+        _request.Reference(";multicast");
+    }
+    else
+    {
+        unsigned short rtp_port = 0, rtcp_port = 0;
+        ErrorType res = setAvailableRTPPort(SEARCH_PORT_RTP_FROM, rtp_port, rtcp_port);
+        if (RTSP_NO_ERROR != res)
         {
-            Msg << "Transport:" << " " << transport << "/TCP;";
-            Msg << "interleaved=0-1\r\n";
+            return res;
         }
-        else
-        {
-            unsigned short rtp_port = 0, rtcp_port = 0;
-            res = setAvailableRTPPort(SEARCH_PORT_RTP_FROM, rtp_port, rtcp_port);
-            if (RTSP_NO_ERROR != res)
-            {
-                break;
-            }
 
-            _sdp_info.ParseMediaRtpPort(media_type, rtp_port, rtcp_port);
+        _sdp_info.ParseMediaRtpPort(media_type, rtp_port, rtcp_port);
 
-            Msg << "Transport:" << " " << transport << ";";
-            Msg << "unicast;" << "client_port=" << rtp_port << "-" << rtcp_port << "\r\n";
-        }
+        _request.Reference(";unicast;client_port=");
+        _request.Append((unsigned int)rtp_port);
+        _request.Reference("-");
+        _request.Append((unsigned int)rtcp_port);
+    }
+    _request.Reference("\r\n");
 
-        Msg << "CSeq: " << ++_CSeq << "\r\n";
-        Msg << HTTP_HEAD_USER_AGENT << HTTP_HEAD_VALUE_USER_AGENT << "\r\n";
-        if (_realm.length() > 0 && _nonce.length() > 0) 
-        {
-            /* digest auth */
-            std::string Md5Response = makeMd5DigestResp(_realm, Cmd, control_uri, _nonce);
-            if (Md5Response.length() != MD5_SIZE) 
-            {
-                std::cerr << "Make MD5 digest response error" << std::endl;
-                return RTSP_RESPONSE_401;
-            }
-            Msg << "Authorization: Digest username=\"" << _username << "\", realm=\""
-                << _realm << "\", nonce=\"" << _nonce << "\", uri=\"" << control_uri
-                << "\", response=\"" << Md5Response << "\"\r\n";
-        }
-        else if (_realm.length() > 0) 
+    ErrorType res = addAuthorization(Cmd, control_uri);
+    _request.Reference("\r\n");
+    return res;
+}
+
+ErrorType RtspClient::onSETUP(const std::string& media_type, const std::string& response)
+{
+    // check username and password, if any
+    if (checkResponse(response) != RTSP_RESPONSE_200)
+    {
+        return RTSP_NEGOTIATION_AUTH;
+    }
+
+    _sdp_info.ParseMediaSessionInfomation(media_type, response);
+    return RTSP_NO_ERROR;
+}
+
+ErrorType RtspClient::doSETUP(const std::string& media_type, bool rtp_over_tcp)
+{
+    ErrorType res = RTSP_NO_ERROR;
+    do 
+    {
+        res = makeSETUP(media_type, rtp_over_tcp);
+        if (RTSP_NO_ERROR != res)
         {
-            /* basic auth */
-            Msg << "Authorization: Basic " << makeBasicResp();
+            break;
         }
-        Msg << "\r\n";
 
-        res = sendRTSP(Msg.str());
+        res = sendRequest();
         if (RTSP_NO_ERROR != res) 
         {
             break;
@@ -606,78 +801,64 @@ ErrorType RtspClient::doSETUP(const std::string& media_type, bool rtp_over_tcp)
             break;
         }
 
-        // check username and password, if any
-        res = checkResponse(response);
-        if (res != RTSP_RESPONSE_200)
+        res = onSETUP(media_type, response);
+        if (RTSP_NO_ERROR != res)
         {
-            res = RTSP_NEGOTIATION_AUTH;
             break;
         }
-        else
+
+        // from here on media data may arrive between the RTSP replies
+        if (rtp_over_tcp && _over_http_data_port == 0 && !_demuxer.Running() && _demuxer.Start(_rtsp_socket) < 0)
         {
-            res = RTSP_NO_ERROR;
+            LOG_ERROR(_log_tag.c_str(), "start interleaved demuxer error: %d", errno);
+            res = RTSP_RTP_ERROR;
         }
-
-        _sdp_info.ParseMediaSessionInfomation(media_type, response);
     } while (false);
     return res;
 }
 
-ErrorType RtspClient::doPLAY(const std::string& media_type, double start_time, double* end_time, double* scale)
+ErrorType RtspClient::makePLAY(const std::string& media_type, double start_time, const double* end_time, const double* scale)
 {
     static const std::string Cmd("PLAY");
 
-    ErrorType res = RTSP_NO_ERROR;
-    do
+    beginRequest(Cmd, _uri);
+    if (scale)
     {
-        std::stringstream Msg("");
-        Msg << Cmd << " " << _uri << " " << "RTSP/" << VERSION_RTSP << "\r\n";
-        if (scale)
-        {
-            char floatChar[32];
-            sprintf(floatChar, "%.1f", *scale);
-            Msg << "Scale: " << floatChar << "\r\n";
-        }
+        _request.Reference("Scale: ");
+        _request.Append(*scale);
+        _request.Reference("\r\n");
+    }
 
-        char floatChar[32] = { 0 };
-        Msg << "Range: npt=";
-        sprintf(floatChar, "%.1f", start_time);
-        Msg << floatChar;
+    _request.Reference("Range: npt=");
+    _request.Append(start_time);
+    _request.Reference("-");
+    if (end_time)
+    {
+        _request.Append(*end_time);
+    }
+    _request.Reference("\r\n");
 
-        Msg << "-";
-        if (end_time)
-        {
-            sprintf(floatChar, "%.1f", *end_time);
-            Msg << floatChar;
-        }
-        Msg << "\r\n";
+    _request.Reference("Session: ");
+    _request.Append(_sdp_info.GetMediaSessionID(media_type));
+    _request.Reference("\r\n");
 
-        Msg << "CSeq: " << ++_CSeq << "\r\n";
-        Msg << HTTP_HEAD_USER_AGENT << HTTP_HEAD_VALUE_USER_AGENT << "\r\n";
-        Msg << "Session: " << _sdp_info.GetMediaSessionID(media_type) << "\r\n";
-        if (_realm.length() > 0 && _nonce.length() > 0)
-        {
-            /* digest auth */
-            std::string Md5Response = makeMd5DigestResp(_realm, Cmd, _uri, _nonce);
-            if (Md5Response.length() != MD5_SIZE)
-            {
-                std::cerr << "Make MD5 digest response error" << std::endl;
-                res = RTSP_RESPONSE_401;
-                break;
-            }
-            Msg << "Authorization: Digest username=\"" << _username << "\", realm=\""
-                << _realm << "\", nonce=\"" << _nonce << "\", uri=\"" << _uri
-                << "\", response=\"" << Md5Response << "\"\r\n";
-        }
-        else if (_realm.length() > 0)
+    ErrorType res = addAuthorization(Cmd, _uri);
+    _request.Reference("\r\n");
+    return res;
+}
+
+ErrorType RtspClient::doPLAY(const std::string& media_type, double start_time, double* end_time, double* scale)
+{
+    ErrorType res = RTSP_NO_ERROR;
+    do
+    {
+        res = makePLAY(media_type, start_time, end_time, scale);
+        if (RTSP_NO_ERROR != res)
         {
-            /* basic auth */
-            std::string BasicResponse = makeBasicResp();
-            Msg << "Authorization: Basic " << BasicResponse;
+            break;
         }
-        Msg << "\r\n";
 
-        res = sendRTSP(Msg.str());
+        res = sendRequest();
         if (RTSP_NO_ERROR != res)
         {
             break;
@@ -761,26 +942,34 @@ std::string RtspClient::makeBasicResp(const std::string& username, const std::st
 }
 
 RtspClient::RtspClient()
-    : _uri(""), _uri_without_user_info()
+    : _log_tag("rtsp")
+    , _uri(""), _uri_without_user_info()
     , _address(""), _port(PORT_RTSP)
     , _username(""), _password(""), _realm(""), _nonce("")
-    , _rtsp_socket(INVALID_SOCKET)
+    , _rtsp_socket(INVALID_SOCKET), _demuxer(), _recv_buffer()
+    , _multicast(false), _multicast_interface()
     , _over_http_data_port(0)
     , _over_http_data_socket(INVALID_SOCKET)
-    , _CSeq(0)
+    , _connect_timeout_ms(CONNECT_TIMEOUT_MS), _send_timeout_ms(SEND_TIMEOUT_MS)
+    , _recv_header_timeout_ms(RECV_HEADER_TIMEOUT_MS), _recv_body_timeout_ms(RECV_BODY_TIMEOUT_MS)
+    , _CSeq(0), _request()
     , _sdp(), _sdp_info()
 {
     disconnect_callback = NULL;
 }
 
 RtspClient::RtspClient(const std::string& uri)
-    : _uri(uri), _uri_without_user_info()
+    : _log_tag("rtsp")
+    , _uri(uri), _uri_without_user_info()
     , _address(""), _port(PORT_RTSP)
     , _username(""), _password(""), _realm(""), _nonce("")
-    , _rtsp_socket(INVALID_SOCKET)
+    , _rtsp_socket(INVALID_SOCKET), _demuxer(), _recv_buffer()
+    , _multicast(false), _multicast_interface()
     , _over_http_data_port(0)
     , _over_http_data_socket(INVALID_SOCKET)
-    , _CSeq(0)
+    , _connect_timeout_ms(CONNECT_TIMEOUT_MS), _send_timeout_ms(SEND_TIMEOUT_MS)
+    , _recv_header_timeout_ms(RECV_HEADER_TIMEOUT_MS), _recv_body_timeout_ms(RECV_BODY_TIMEOUT_MS)
+    , _CSeq(0), _request()
     , _sdp(), _sdp_info()
 {
     disconnect_callback = NULL;
@@ -788,15 +977,36 @@ RtspClient::RtspClient(const std::string& uri)
 
 RtspClient::~RtspClient()
 {
+    _demuxer.Stop();
     _over_http_data_port = 0;
     Close_Socket(_rtsp_socket);
     Close_Socket(_over_http_data_socket);
 }
 
-ErrorType RtspClient::DoOPTIONS(const std::string& uri)
+void RtspClient::makeOPTIONS()
 {
     static const std::string Cmd = "OPTIONS";
 
+    beginRequest(Cmd, _uri);
+    _request.Reference("\r\n");
+}
+
+void RtspClient::SetTimeouts(int connect_ms, int send_ms, int recv_header_ms, int recv_body_ms)
+{
+    _connect_timeout_ms = connect_ms;
+    _send_timeout_ms = send_ms;
+    _recv_header_timeout_ms = recv_header_ms;
+    _recv_body_timeout_ms = recv_body_ms;
+}
+
+void RtspClient::SetMulticast(bool multicast, const std::string& interface)
+{
+    _multicast = multicast;
+    _multicast_interface = interface;
+}
+
+ErrorType RtspClient::DoOPTIONS(const std::string& uri)
+{
     if (!uri.empty())
     {
         _uri = uri;
@@ -819,13 +1029,8 @@ ErrorType RtspClient::DoOPTIONS(const std::string& uri)
             break;
         }
 
-        std::stringstream Msg;
-        Msg << Cmd << " " << _uri << " " << "RTSP/" << VERSION_RTSP << "\r\n";
-        Msg << "CSeq: " << ++_CSeq << "\r\n";
-        Msg << HTTP_HEAD_USER_AGENT << HTTP_HEAD_VALUE_USER_AGENT << "\r\n";
-        Msg << "\r\n";
-
-        res = sendRTSP(Msg.str());
+        makeOPTIONS();
+        res = sendRequest();
         if (RTSP_NO_ERROR != res)
         {
             break;
@@ -851,18 +1056,29 @@ ErrorType RtspClient::DoOPTIONS(const std::string& uri)
     return res;
 }
 
-ErrorType RtspClient::DoDESCRIBE()
+void RtspClient::makeDESCRIBE()
 {
     static const std::string Cmd("DESCRIBE");
 
-    std::stringstream Msg;
-    Msg << Cmd << " " << _uri << " " << "RTSP/" << VERSION_RTSP << "\r\n";
-    Msg << "CSeq: " << ++_CSeq << "\r\n";
-    Msg << HTTP_HEAD_USER_AGENT << HTTP_HEAD_VALUE_USER_AGENT << "\r\n";
-    Msg << HTTP_HEAD_ACCEPT << "application/sdp" << "\r\n";
-    Msg << "\r\n";
+    beginRequest(Cmd, _uri);
+    _request.Reference(s_request_accept_sdp);
+    _request.Reference("\r\n");
+}
+
+ErrorType RtspClient::onDESCRIBE(const std::string& response)
+{
+    ErrorType res = recvSDP(response, _sdp);
+    if (RTSP_NO_ERROR == res)
+    {
+        parseSDP(_sdp);
+    }
+    return res;
+}
 
-    ErrorType res = sendRTSP(Msg.str());
+ErrorType RtspClient::DoDESCRIBE()
+{
+    makeDESCRIBE();
+    ErrorType res = sendRequest();
     do 
     {
         if (RTSP_NO_ERROR != res) 
@@ -878,24 +1094,16 @@ ErrorType RtspClient::DoDESCRIBE()
         }
 
         res = checkResponse(response);
-        if (res != RTSP_RESPONSE_401)
+        if (res == RTSP_RESPONSE_401)
         {
-            break;
+            res = doAuth(response, "DESCRIBE", _uri);
         }
-
-        res = doAuth(response, Cmd, _uri);
         if (res != RTSP_RESPONSE_200)
         {
             break;
         }
 
-        res = recvSDP(response, _sdp);
-        if (RTSP_NO_ERROR != res)
-        {
-            break;
-        }
-
-        parseSDP(_sdp);
+        res = onDESCRIBE(response);
     } while (false);
     return res;
 }
@@ -1108,10 +1316,22 @@ ErrorType RtspClient::DoGET_PARAMETER(const std::string& media_type, bool http_t
     return Err;
 }
 
-ErrorType RtspClient::DoTEARDOWN()
+ErrorType RtspClient::makeTEARDOWN(const std::string& media_type)
 {
     static const std::string Cmd("TEARDOWN");
-    
+
+    beginRequest(Cmd, _uri);
+    _request.Reference("Session: ");
+    _request.Append(_sdp_info.GetMediaSessionID(media_type));
+    _request.Reference("\r\n");
+
+    ErrorType res = addAuthorization(Cmd, _uri);
+    _request.Reference("\r\n");
+    return res;
+}
+
+ErrorType RtspClient::DoTEARDOWN()
+{
     ErrorType res = RTSP_NO_ERROR;
 
     const SDPData::MediaArray& media_array = _sdp_info.GetMedia();
@@ -1119,32 +1339,13 @@ ErrorType RtspClient::DoTEARDOWN()
     {
         if (!media.session.empty())
         {
-            std::stringstream Msg("");
-            Msg << Cmd << " " << _uri << " " << "RTSP/" << VERSION_RTSP << "\r\n";
-            Msg << "CSeq: " << ++_CSeq << "\r\n";
-            Msg << "Session: " << _sdp_info.GetMediaSessionID(media.type) << "\r\n";
-            if (_realm.length() > 0 && _nonce.length() > 0)
-            {
-                /* digest auth */
-                std::string Md5Response = makeMd5DigestResp(_realm, Cmd, _uri, _nonce);
-                if (Md5Response.length() != MD5_SIZE) {
-                    std::cerr << "Make MD5 digest response error" << std::endl;
-                    res = RTSP_RESPONSE_401;
-                    break;
-                }
-                Msg << "Authorization: Digest username=\"" << _username << "\", realm=\""
-                    << _realm << "\", nonce=\"" << _nonce << "\", uri=\"" << _uri
-                    << "\", response=\"" << Md5Response << "\"\r\n";
-            }
-            else if (_realm.length() > 0)
+            res = makeTEARDOWN(media.type);
+            if (RTSP_NO_ERROR != res)
             {
-                /* basic auth */
-                std::string BasicResponse = makeBasicResp();
-                Msg << "Authorization: Basic " << BasicResponse;
+                break;
             }
-            Msg << "\r\n";
 
-            res = sendRTSP(Msg.str());
+            res = sendRequest();
             if (RTSP_NO_ERROR != res)
             {
                 break;
@@ -1154,6 +1355,7 @@ ErrorType RtspClient::DoTEARDOWN()
 
     if (RTSP_NO_ERROR == res)
     {
+        _demuxer.Stop();
         _over_http_data_port = 0;
         Close_Socket(_over_http_data_socket);
         Close_Socket(_rtsp_socket);
@@ -1177,6 +1379,22 @@ void RtspClient::GetMediaEndpoints(const std::string& media_type, Endpoint& serv
     }
 }
 
+int RtspClient::GetMediaMulticast(const std::string& media_type, MulticastEndpoint& multicast)
+{
+    if (_sdp_info.GetMediaMulticast(media_type, multicast) < 0)
+    {
+        return -1;
+    }
+
+    // neither SDP nor reply named the sender of a source-specific group, it is the server itself then
+    if (multicast.source.empty() && MulticastGroup::IsSourceSpecific(multicast.group))
+    {
+        multicast.source = _address;
+    }
+    multicast.interface = _multicast_interface;
+    return 0;
+}
+
 int RtspClient::GetMediaTimeRate(const std::string& media_type)
 {
     const SDPData::MediaArray& media_array = _sdp_info.GetMedia();
@@ -1190,6 +1408,47 @@ int RtspClient::GetMediaTimeRate(const std::string& media_type)
     return 10;
 }
 
+int RtspClient::GetMediaChannels(const std::string& media_type, int& rtp_channel, int& rtcp_channel)
+{
+    const SDPData::MediaArray& media_array = _sdp_info.GetMedia();
+    for (const SDPData::Media& media : media_array)
+    {
+        if (media_type == media.type)
+        {
+            rtp_channel = media.rtp_channel;
+            rtcp_channel = media.rtcp_channel;
+            return (rtp_channel < 0) ? -1 : 0;
+        }
+    }
+    return -1;
+}
+
+std::string RtspClient::GetMediaCodec(const std::string& media_type)
+{
+    const SDPData::MediaArray& media_array = _sdp_info.GetMedia();
+    for (const SDPData::Media& media : media_array)
+    {
+        if (media_type == media.type)
+        {
+            return media.codec;
+        }
+    }
+    return "";
+}
+
+std::string RtspClient::GetMediaFmtp(const std::string& media_type)
+{
+    const SDPData::MediaArray& media_array = _sdp_info.GetMedia();
+    for (const SDPData::Media& media : media_array)
+    {
+        if (media_type == media.type)
+        {
+            return media.fmtp;
+        }
+    }
+    return "";
+}
+
 ErrorType RtspClient::DoRtspOverHttpGet()
 {
 #ifdef _MSC_VER
@@ -1305,7 +1564,7 @@ int RtspClient::connectToRtspServer(uint16_t rtsp_over_http_data_port)
     Servaddr.sin_port = htons(rtsp_over_http_data_port);
     Servaddr.sin_addr.s_addr = GetIP(RtspUri);
 
-    if(connect(Sockfd, (struct sockaddr *)&Servaddr, sizeof(Servaddr)) < 0 && errno != EINPROGRESS) {
+    if(connect(Sockfd, (struct sockaddr *)&Servaddr, sizeof(Servaddr)) < 0 && !LastSocketErrorWouldBlock()) {
         perror("connect error");
 #ifdef _MSC_VER
         closesocket(Sockfd);
@@ -1373,3 +1632,294 @@ std::string RtspClient::UpdateXSessionCookie()
 //     return media_session->GetMediaData(buf, size, max_size);
 // }
 
+#ifdef RTSP_COROUTINE
+
+Task<ErrorType> RtspClient::Options(EventLoop& loop, std::string uri)
+{
+    if (!uri.empty())
+    {
+        _uri = uri;
+    }
+    if (_uri.empty() || !checkRtspUri(_uri))
+    {
+        co_return RTSP_INVALID_URI;
+    }
+
+    parseAddressAndPort(_uri_without_user_info);
+
+    ErrorType res = co_await connectAsync(loop);
+    if (RTSP_NO_ERROR != res)
+    {
+        co_return res;
+    }
+
+    std::string response;
+    makeOPTIONS();
+    res = co_await requestAsync(loop, response);
+    if (RTSP_NO_ERROR != res)
+    {
+        co_return res;
+    }
+
+    res = checkResponse(response);
+    co_return (RTSP_RESPONSE_200 == res) ? RTSP_NO_ERROR : res;
+}
+
+Task<ErrorType> RtspClient::Describe(EventLoop& loop)
+{
+    std::string response;
+    makeDESCRIBE();
+    ErrorType res = co_await requestAsync(loop, response);
+    if (RTSP_NO_ERROR != res)
+    {
+        co_return res;
+    }
+
+    res = checkResponse(response);
+    if (RTSP_RESPONSE_401 == res)
+    {
+        res = makeAuth(response, "DESCRIBE", _uri);
+        if (RTSP_NO_ERROR != res)
+        {
+            co_return res;
+        }
+
+        res = co_await requestAsync(loop, response);
+        if (RTSP_NO_ERROR != res)
+        {
+            co_return res;
+        }
+        res = checkResponse(response);
+    }
+    if (RTSP_RESPONSE_200 != res)
+    {
+        co_return res;
+    }
+
+    co_return onDESCRIBE(response);
+}
+
+Task<ErrorType> RtspClient::Setup(EventLoop& loop, std::string media_type)
+{
+    ErrorType res = RTSP_NO_ERROR;
+    if ("all" == media_type)
+    {
+        const SDPData::MediaArray& media_array = _sdp_info.GetMedia();
+        for (size_t i = 0; i < media_array.size() && RTSP_NO_ERROR == res; ++i)
+        {
+            res = co_await setupAsync(loop, media_array[i].type);
+        }
+    }
+    else
+    {
+        res = co_await setupAsync(loop, media_type);
+    }
+    co_return res;
+}
+
+Task<ErrorType> RtspClient::Play(EventLoop& loop, std::string media_type, double start_time, double* end_time, double* scale)
+{
+    ErrorType res = RTSP_NO_ERROR;
+    if ("all" == media_type)
+    {
+        const SDPData::MediaArray& media_array = _sdp_info.GetMedia();
+        for (size_t i = 0; i < media_array.size() && RTSP_NO_ERROR == res; ++i)
+        {
+            res = co_await playAsync(loop, media_array[i].type, start_time, end_time, scale);
+        }
+    }
+    else
+    {
+        res = co_await playAsync(loop, media_type, start_time, end_time, scale);
+    }
+    co_return res;
+}
+
+Task<ErrorType> RtspClient::Teardown(EventLoop& loop)
+{
+    ErrorType res = RTSP_NO_ERROR;
+    std::string response;
+    const SDPData::MediaArray& media_array = _sdp_info.GetMedia();
+    for (size_t i = 0; i < media_array.size() && RTSP_NO_ERROR == res; ++i)
+    {
+        if (!media_array[i].session.empty())
+        {
+            // every reply is read before the next request, whatever its status the session is gone
+            res = makeTEARDOWN(media_array[i].type);
+            if (RTSP_NO_ERROR == res)
+            {
+                res = co_await requestAsync(loop, response);
+            }
+        }
+    }
+
+    if (RTSP_NO_ERROR == res)
+    {
+        Close_Socket(_rtsp_socket);
+        _recv_buffer.clear();
+    }
+    co_return res;
+}
+
+Task<ErrorType> RtspClient::setupAsync(EventLoop& loop, std::string media_type)
+{
+    std::string response;
+    ErrorType res = makeSETUP(media_type, false);
+    if (RTSP_NO_ERROR != res)
+    {
+        co_return res;
+    }
+
+    res = co_await requestAsync(loop, response);
+    if (RTSP_NO_ERROR != res)
+    {
+        co_return res;
+    }
+    co_return onSETUP(media_type, response);
+}
+
+Task<ErrorType> RtspClient::playAsync(EventLoop& loop, std::string media_type, double start_time, double* end_time, double* scale)
+{
+    std::string response;
+    ErrorType res = makePLAY(media_type, start_time, end_time, scale);
+    if (RTSP_NO_ERROR != res)
+    {
+        co_return res;
+    }
+
+    res = co_await requestAsync(loop, response);
+    if (RTSP_NO_ERROR != res)
+    {
+        co_return res;
+    }
+
+    res = checkResponse(response);
+    co_return (RTSP_RESPONSE_200 == res) ? RTSP_NO_ERROR : res;
+}
+
+Task<ErrorType> RtspClient::connectAsync(EventLoop& loop)
+{
+    Close_Socket(_rtsp_socket);
+    _recv_buffer.clear();
+
+    _rtsp_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (INVALID_SOCKET == _rtsp_socket)
+    {
+        co_return RTSP_SOCKET_INIT;
+    }
+    if (setNonBlocking(_rtsp_socket) < 0)
+    {
+        Close_Socket(_rtsp_socket);
+        co_return RTSP_SOCKET_INIT;
+    }
+
+    struct sockaddr_in serv_addr;
+    memset(&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_port = htons(_port);
+    serv_addr.sin_addr.s_addr = inet_addr(_address.c_str());
+
+    if (connect(_rtsp_socket, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0)
+    {
+        if (!LastSocketErrorWouldBlock())
+        {
+            Close_Socket(_rtsp_socket);
+            co_return RTSP_SOCKET_CONNECT;
+        }
+
+        // the outcome of a non-blocking connect is reported once the socket turns writable
+        int error = 0;
+        socklen_t length = sizeof(error);
+        int ready = co_await loop.Writable(_rtsp_socket, _connect_timeout_ms);
+        if (ready < 0 || getsockopt(_rtsp_socket, SOL_SOCKET, SO_ERROR, (char*)&error, &length) < 0 || error != 0)
+        {
+            Close_Socket(_rtsp_socket);
+            co_return (EVENT_LOOP_TIMEOUT == ready) ? RTSP_TIMEOUT : RTSP_SOCKET_CONNECT;
+        }
+    }
+    co_return RTSP_NO_ERROR;
+}
+
+Task<ErrorType> RtspClient::sendAsync(EventLoop& loop)
+{
+    Deadline deadline = deadlineIn(_send_timeout_ms);
+    while (!_request.Sent())
+    {
+        int res = _request.Send(_rtsp_socket);
+        if (res > 0)
+        {
+            continue;
+        }
+        if (res < 0 && LastSocketErrorInterrupted())
+        {
+            continue;
+        }
+        if (res < 0 && LastSocketErrorWouldBlock())
+        {
+            int ready = co_await loop.Writable(_rtsp_socket, msLeft(deadline));
+            if (ready == 0)
+            {
+                continue;
+            }
+            if (EVENT_LOOP_TIMEOUT == ready)
+            {
+                co_return RTSP_TIMEOUT;
+            }
+        }
+        co_return RTSP_SEND_ERROR;
+    }
+    co_return RTSP_NO_ERROR;
+}
+
+Task<ErrorType> RtspClient::recvAsync(EventLoop& loop, std::string& response)
+{
+    char data[RECV_BUF_SIZE];
+    int taken = 0;
+    bool body = false;
+    Deadline deadline = deadlineIn(_recv_header_timeout_ms);
+    while ((taken = takeMessage(response)) == 0)
+    {
+        if (!body && RtspResponse::HeaderLength(_recv_buffer) > 0)
+        {
+            body = true;
+            deadline = deadlineIn(_recv_body_timeout_ms);
+        }
+
+        ssize_t res = recv(_rtsp_socket, data, sizeof(data), 0);
+        if (res > 0)
+        {
+            _recv_buffer.append(data, (size_t)res);
+            continue;
+        }
+        if (res < 0 && LastSocketErrorInterrupted())
+        {
+            continue;
+        }
+        if (res < 0 && LastSocketErrorWouldBlock())
+        {
+            int ready = co_await loop.Readable(_rtsp_socket, msLeft(deadline));
+            if (ready == 0)
+            {
+                continue;
+            }
+            if (EVENT_LOOP_TIMEOUT == ready)
+            {
+                co_return RTSP_TIMEOUT;
+            }
+        }
+        co_return RTSP_RECV_ERROR;
+    }
+    co_return (taken > 0) ? RTSP_NO_ERROR : RTSP_RECV_ERROR;
+}
+
+Task<ErrorType> RtspClient::requestAsync(EventLoop& loop, std::string& response)
+{
+    ErrorType res = co_await sendAsync(loop);
+    if (RTSP_NO_ERROR == res)
+    {
+        res = co_await recvAsync(loop, response);
+    }
+    co_return res;
+}
+
+#endif // RTSP_COROUTINE
@@ -17,20 +17,12 @@
 #define __RTSP_CLIENT_H__
 
 #include "SDPData.h"
+#include "InterleavedDemuxer.h"
+#include "RtspRequest.h"
+#include "EventLoop.h"
 
 #include <string>
 
-#ifdef _MSC_VER
-#include <winsock2.h>
-#else
-#include <netinet/in.h>
-#include <arpa/inet.h>
-
-typedef int SOCKET;
-#define INVALID_SOCKET -1
-
-#endif
-
 #include <stdio.h>
 
 enum ErrorType {
@@ -47,6 +39,7 @@ enum ErrorType {
     RTSP_PARSE_SDP_LENGTH_ERROR,
     RTSP_INVALID_MEDIA_SESSION,
     RTSP_RESPONSE_BLANK,
+    RTSP_TIMEOUT,
     RTSP_RESPONSE_200 = 200,
     RTSP_RESPONSE_400 = 400,
     RTSP_RESPONSE_401 = 401,
@@ -70,6 +63,22 @@ public:
     explicit RtspClient(const std::string& uri);
     ~RtspClient();
 
+    /* Prefix of every log line of this client, e.g. the camera name */
+    inline void SetLogTag(const std::string& tag) { _log_tag = tag; }
+
+    /* Ask for multicast transport in the SETUP of UDP media, must be called before DoSETUP.
+    * A server without multicast for the stream refuses the SETUP (461), set up unicast instead then.
+    * interface: local interface name to join the groups on, empty lets the routing table decide
+    * */
+    void SetMulticast(bool multicast, const std::string& interface = "");
+
+    /* Deadlines in milliseconds for a single connect, request, reply header block and reply body.
+    * Exceeding one fails the command with RTSP_TIMEOUT, the connection is out of step then and has to be
+    * opened again with DoOPTIONS. A negative deadline waits without limit.
+    * Defaults: 5000, 5000, 10000 and 10000
+    * */
+    void SetTimeouts(int connect_ms, int send_ms, int recv_header_ms, int recv_body_ms);
+
     ErrorType DoOPTIONS(const std::string& uri = "");
 
     ErrorType DoDESCRIBE();
@@ -107,10 +116,40 @@ public:
     /* To teardown all of the media sessions in SDP */
     ErrorType DoTEARDOWN();
 
+#ifdef RTSP_COROUTINE
+    /* Awaitable versions of the commands above, the same arguments and results:
+    *    ErrorType res = co_await client.Describe(loop);
+    * Every wait for the server is a suspension on 'loop' with the socket non-blocking, so any number of
+    * clients can negotiate at once on the thread running the loop. The waits end by the deadlines of SetTimeouts.
+    * Media is set up over UDP only, and a client uses either these or the Do* calls, not both.
+    * Teardown waits for the reply to each TEARDOWN before closing the connection.
+    * Pointer arguments must stay valid until the task finished.
+    * */
+    Task<ErrorType> Options(EventLoop& loop, std::string uri = "");
+    Task<ErrorType> Describe(EventLoop& loop);
+    Task<ErrorType> Setup(EventLoop& loop, std::string media_type);
+    Task<ErrorType> Play(EventLoop& loop, std::string media_type, double start_time = 0.0, double* end_time = nullptr, double* scale = nullptr);
+    Task<ErrorType> Teardown(EventLoop& loop);
+#endif
+
 public:
+    /* Non-blocking once connected */
     inline SOCKET GetTcpSocket() { return _rtsp_socket; }
+
+    /* Reads the RTSP connection once a media was set up with rtp_over_tcp, RTSP replies keep working
+    * through it. Hand it to RtpClient::Create together with the channels of GetMediaChannels */
+    inline InterleavedDemuxer* GetInterleavedDemuxer() { return &_demuxer; }
+    int GetMediaChannels(const std::string& media_type, int& rtp_channel, int& rtcp_channel);
     void GetMediaEndpoints(const std::string& media_type, Endpoint& server, Endpoint& client);
+
+    /* Group to hand to RtpClient::Create for a media set up as multicast (see SetMulticast).
+    * return:
+    *    -1 if the server granted no multicast transport for it
+    * */
+    int GetMediaMulticast(const std::string& media_type, MulticastEndpoint& multicast);
     int GetMediaTimeRate(const std::string& media_type);
+    std::string GetMediaCodec(const std::string& media_type);
+    std::string GetMediaFmtp(const std::string& media_type);
 
 private:
     bool checkRtspUri(const std::string& uri);
@@ -119,10 +158,22 @@ private:
     ErrorType connectToRtspServer();
 
 private:
-    ErrorType checkSockWritable(SOCKET sockfd, struct timeval * tval = NULL);
-    ErrorType checkSockReadable(SOCKET sockfd, struct timeval * tval = NULL);
+    /* Poll 'sockfd' for up to 'timeout_ms', -1 without limit.
+    * return:
+    *    RTSP_TIMEOUT if it did not turn ready in time
+    * */
+    ErrorType checkSockWritable(SOCKET sockfd, int timeout_ms);
+    ErrorType checkSockReadable(SOCKET sockfd, int timeout_ms);
+    ErrorType waitSocket(SOCKET sockfd, short events, int timeout_ms);
 
+    /* One whole reply, headers and Content-Length body, read through _recv_buffer */
     ErrorType recvRTSP(SOCKET fd, std::string& msg);
+
+    /* Move the first whole reply out of _recv_buffer.
+    * return:
+    *    1 with a reply, 0 while it is incomplete, -1 once the buffer outgrew any sane reply
+    * */
+    int takeMessage(std::string& msg);
     ErrorType sendRTSP(SOCKET fd, const std::string& msg);
 
     ErrorType recvSDP(SOCKET sockfd, char * msg, size_t size);
@@ -130,9 +181,38 @@ private:
     ErrorType sendRTSP(const std::string& msg);
     ErrorType recvRTSP(std::string& msg);
 
+    /* Send _request, through the tunnel if there is one */
+    ErrorType sendRequest();
+
     ErrorType checkResponse(const std::string& response);
+    ErrorType makeAuth(const std::string& response, const std::string& cmd, const std::string& uri);
     ErrorType doAuth(std::string& response, const std::string& cmd, const std::string& uri);
 
+    /* Request line, CSeq and User-Agent of a new request in _request */
+    void beginRequest(const std::string& cmd, const std::string& uri);
+
+    /* Authorization header answering the last challenge, if there was one */
+    ErrorType addAuthorization(const std::string& cmd, const std::string& uri);
+
+    /* Requests, built in _request, and reply handling shared by the Do* calls and their awaitable versions */
+    void makeOPTIONS();
+    void makeDESCRIBE();
+    ErrorType onDESCRIBE(const std::string& response);
+    ErrorType makeSETUP(const std::string& media_type, bool rtp_over_tcp);
+    ErrorType onSETUP(const std::string& media_type, const std::string& response);
+    ErrorType makePLAY(const std::string& media_type, double start_time, const double* end_time, const double* scale);
+    ErrorType makeTEARDOWN(const std::string& media_type);
+
+#ifdef RTSP_COROUTINE
+    Task<ErrorType> setupAsync(EventLoop& loop, std::string media_type);
+    Task<ErrorType> playAsync(EventLoop& loop, std::string media_type, double start_time, double* end_time, double* scale);
+
+    Task<ErrorType> connectAsync(EventLoop& loop);
+    Task<ErrorType> sendAsync(EventLoop& loop);
+    Task<ErrorType> recvAsync(EventLoop& loop, std::string& response);
+    Task<ErrorType> requestAsync(EventLoop& loop, std::string& response);
+#endif
+
     ErrorType recvSDP(const std::string& response, std::string& msg);
     
     void parseSDP(const std::string& sdp);
@@ -175,6 +255,9 @@ private:
     ErrorType DoRtspOverHttpGet();
     ErrorType DoRtspOverHttpPost();
 
+private:
+    std::string _log_tag;
+
 private:
     std::string _uri;
     std::string _uri_without_user_info;
@@ -193,15 +276,27 @@ private:
 
 private:
     SOCKET _rtsp_socket;
+    InterleavedDemuxer _demuxer;
+    std::string _recv_buffer;   // received beyond the last whole reply
 
     ServerDisconnectCallback disconnect_callback;
 
+    bool _multicast;
+    std::string _multicast_interface;
+
 private:
     uint16_t _over_http_data_port;
     SOCKET  _over_http_data_socket;
 
+private:
+    int _connect_timeout_ms;
+    int _send_timeout_ms;
+    int _recv_header_timeout_ms;
+    int _recv_body_timeout_ms;
+
 private:
     unsigned int _CSeq;
+    RtspRequest _request;   // the request being sent, its buffers are reused by the next
 
 private:
     std::string _sdp;
@@ -0,0 +1,156 @@
+
+#include "RtspRequest.h"
+
+#include <charconv>
+
+#include <sys/types.h>
+#ifndef _MSC_VER
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+#include <string.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL    0
+#endif
+
+RtspRequest::RtspRequest()
+    : _buffer(), _segments(), _size(0)
+    , _sent_segment(0), _sent_offset(0)
+{
+}
+
+void RtspRequest::Clear()
+{
+    _buffer.clear();
+    _segments.clear();
+    _size = 0;
+    _sent_segment = 0;
+    _sent_offset = 0;
+}
+
+void RtspRequest::Reference(std::string_view text)
+{
+    if (!text.empty())
+    {
+        Segment segment = { text.data(), 0, text.size() };
+        _segments.push_back(segment);
+        _size += text.size();
+    }
+}
+
+void RtspRequest::Append(std::string_view text)
+{
+    appendBuffer(text.data(), text.size());
+}
+
+void RtspRequest::Append(unsigned int number)
+{
+    char digits[16];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), number);
+    appendBuffer(digits, result.ptr - digits);
+}
+
+void RtspRequest::Append(double number)
+{
+    char digits[64];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), number, std::chars_format::fixed);
+    if (result.ec != std::errc())
+    {
+        // too large to write out in fixed notation
+        result = std::to_chars(digits, digits + sizeof(digits), number);
+    }
+    appendBuffer(digits, result.ptr - digits);
+}
+
+std::string RtspRequest::ToString() const
+{
+    std::string request;
+    request.reserve(_size);
+    for (const Segment& segment : _segments)
+    {
+        request.append(segmentData(segment), segment.size);
+    }
+    return request;
+}
+
+int RtspRequest::Send(SOCKET fd)
+{
+#ifdef _MSC_VER
+    WSABUF buffers[RTSP_REQUEST_MAX_IOV];
+#else
+    struct iovec buffers[RTSP_REQUEST_MAX_IOV];
+#endif
+    int count = 0;
+    size_t offset = _sent_offset;
+    for (size_t i = _sent_segment; i < _segments.size() && count < RTSP_REQUEST_MAX_IOV; ++i, ++count)
+    {
+#ifdef _MSC_VER
+        buffers[count].buf = (char*)segmentData(_segments[i]) + offset;
+        buffers[count].len = (ULONG)(_segments[i].size - offset);
+#else
+        buffers[count].iov_base = (void*)(segmentData(_segments[i]) + offset);
+        buffers[count].iov_len = _segments[i].size - offset;
+#endif
+        offset = 0;
+    }
+    if (0 == count)
+    {
+        return 0;
+    }
+
+#ifdef _MSC_VER
+    DWORD written = 0;
+    if (WSASend(fd, buffers, count, &written, 0, NULL, NULL) != 0)
+    {
+        return -1;
+    }
+#else
+    // writev, but without SIGPIPE once the server has gone
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = buffers;
+    message.msg_iovlen = count;
+    ssize_t written = sendmsg(fd, &message, MSG_NOSIGNAL);
+    if (written < 0)
+    {
+        return -1;
+    }
+#endif
+
+    size_t left = (size_t)written;
+    while (left > 0 && _sent_segment < _segments.size())
+    {
+        size_t rest = _segments[_sent_segment].size - _sent_offset;
+        if (left < rest)
+        {
+            _sent_offset += left;
+            break;
+        }
+        left -= rest;
+        _sent_offset = 0;
+        ++_sent_segment;
+    }
+    return (int)written;
+}
+
+void RtspRequest::appendBuffer(const char* data, size_t size)
+{
+    if (0 == size)
+    {
+        return;
+    }
+
+    // runs of copied text share one segment
+    if (!_segments.empty() && !_segments.back().data && _segments.back().offset + _segments.back().size == _buffer.size())
+    {
+        _segments.back().size += size;
+    }
+    else
+    {
+        Segment segment = { nullptr, _buffer.size(), size };
+        _segments.push_back(segment);
+    }
+    _buffer.append(data, size);
+    _size += size;
+}
@@ -0,0 +1,88 @@
+
+/*****************************************************************************
+*                                                                            *
+*  @file     RtspRequest.h                                                   *
+*  @brief    RTSP request builder declaration                                *
+*                                                                            *
+*  Details.                                                                  *
+*    A request is a list of segments, constant text is referenced where it   *
+*    lives and only the variable fields are formatted into a buffer reused   *
+*    from one request to the next. The segments go out with one gathering    *
+*    write, the way they are, without joining them first.                    *
+*                                                                            *
+*----------------------------------------------------------------------------*
+*  Remark   :                                                                *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef __RTSP_REQUEST_HEADER_H__
+#define __RTSP_REQUEST_HEADER_H__
+
+#include "Common.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <stddef.h>
+
+// segments handed to a single write, a request has about a dozen
+#define RTSP_REQUEST_MAX_IOV    32
+
+class RtspRequest
+{
+public:
+    RtspRequest();
+
+    /* Drop the previous request, the buffers keep their capacity */
+    void Clear();
+
+    /* Text that stays untouched until the request is sent, string literals and other constants */
+    void Reference(std::string_view text);
+
+    /* Copied into the request buffer */
+    void Append(std::string_view text);
+    void Append(unsigned int number);
+
+    /* Shortest fixed notation that reads back as 'number', e.g. "20.5" */
+    void Append(double number);
+
+    inline size_t GetSize() const { return _size; }
+    inline bool Sent() const { return _sent_segment >= _segments.size(); }
+
+    /* The whole request in one piece, for transports that have to encode it first */
+    std::string ToString() const;
+
+    /* Write what is left of the request to 'fd' with a single gathering write.
+    * return:
+    *    the bytes written, which may be fewer than left, -1 on error, see LastSocketError
+    * */
+    int Send(SOCKET fd);
+
+private:
+    // 'data' is null for bytes in _buffer, which may move while the request grows
+    struct Segment
+    {
+        const char* data;
+        size_t offset;
+        size_t size;
+    };
+
+    inline const char* segmentData(const Segment& segment) const { return segment.data ? segment.data : _buffer.data() + segment.offset; }
+
+    void appendBuffer(const char* data, size_t size);
+
+private:
+    std::string _buffer;
+    std::vector<Segment> _segments;
+    size_t _size;
+
+    size_t _sent_segment;
+    size_t _sent_offset;    // into the segment at _sent_segment
+
+private:
+    RtspRequest(const RtspRequest& rhs);
+    RtspRequest& operator=(const RtspRequest& rhs);
+};
+
+#endif
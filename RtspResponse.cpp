@@ -0,0 +1,383 @@
+
+#include "RtspResponse.h"
+
+#include <charconv>
+
+#include <ctype.h>
+
+RtspResponse::RtspResponse()
+    : _status(0), _reason(), _body()
+    , _headers(), _header_count(0)
+{
+}
+
+int RtspResponse::Parse(std::string_view message)
+{
+    _status = 0;
+    _reason = std::string_view();
+    _body = std::string_view();
+    _header_count = 0;
+
+    // lines end with CRLF, a bare LF is taken as well
+    size_t off = 0;
+    bool status_line = true;
+    while (off < message.size())
+    {
+        size_t eol = message.find('\n', off);
+        if (std::string_view::npos == eol)
+        {
+            return -1;
+        }
+        std::string_view line = message.substr(off, eol - off);
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        off = eol + 1;
+
+        if (status_line)
+        {
+            // RTSP/1.0 200 OK
+            status_line = false;
+            size_t space = line.find_first_of(" \t");
+            if (line.compare(0, 5, "RTSP/") != 0 || std::string_view::npos == space)
+            {
+                return -1;
+            }
+            std::string_view rest = trim(line.substr(space));
+            size_t end = rest.find_first_of(" \t");
+            if (!toInt(rest.substr(0, end), _status))
+            {
+                return -1;
+            }
+            _reason = (std::string_view::npos == end) ? std::string_view() : trim(rest.substr(end));
+        }
+        else if (line.empty())
+        {
+            _body = message.substr(off);
+            return 0;
+        }
+        else if ((line[0] == ' ' || line[0] == '\t') && _header_count > 0)
+        {
+            // folded onto the previous header, its value now spans the line break
+            Header& header = _headers[_header_count - 1];
+            header.value = std::string_view(header.value.data(), line.data() + line.size() - header.value.data());
+        }
+        else if (_header_count < RTSP_RESPONSE_MAX_HEADERS)
+        {
+            size_t colon = line.find(':');
+            if (std::string_view::npos != colon)
+            {
+                Header& header = _headers[_header_count++];
+                header.name = trim(line.substr(0, colon));
+                header.value = trim(line.substr(colon + 1));
+            }
+        }
+    }
+    return -1;
+}
+
+std::string_view RtspResponse::GetHeader(std::string_view name) const
+{
+    for (int i = 0; i < _header_count; ++i)
+    {
+        if (EqualsNoCase(_headers[i].name, name))
+        {
+            return _headers[i].value;
+        }
+    }
+    return std::string_view();
+}
+
+long long RtspResponse::GetContentLength() const
+{
+    std::string_view value = GetHeader("Content-Length");
+    long long length = -1;
+    std::from_chars_result result = std::from_chars(value.data(), value.data() + value.size(), length);
+    if (value.empty() || result.ec != std::errc() || result.ptr != value.data() + value.size() || length < 0)
+    {
+        return -1;
+    }
+    return length;
+}
+
+int RtspResponse::GetSession(std::string_view& id, int& timeout) const
+{
+    // Session: 1A2B3C4D;timeout=60
+    std::string_view value = GetHeader("Session");
+    if (value.empty())
+    {
+        return -1;
+    }
+
+    size_t semicolon = value.find(';');
+    id = trim(value.substr(0, semicolon));
+    timeout = 0;
+    while (std::string_view::npos != semicolon)
+    {
+        value = value.substr(semicolon + 1);
+        semicolon = value.find(';');
+
+        std::string_view param = trim(value.substr(0, semicolon));
+        size_t equal = param.find('=');
+        if (std::string_view::npos != equal && EqualsNoCase(trim(param.substr(0, equal)), "timeout"))
+        {
+            toInt(trim(param.substr(equal + 1)), timeout);
+        }
+    }
+    return id.empty() ? -1 : 0;
+}
+
+int RtspResponse::GetTransport(Transport& transport) const
+{
+    // Transport: RTP/AVP;unicast;client_port=5000-5001;server_port=6970-6971;source=10.0.0.5
+    std::string_view value = GetHeader("Transport");
+    if (value.empty())
+    {
+        return -1;
+    }
+    value = value.substr(0, value.find(','));
+
+    transport = Transport();
+    size_t semicolon = value.find(';');
+    transport.spec = trim(value.substr(0, semicolon));
+    while (std::string_view::npos != semicolon)
+    {
+        value = value.substr(semicolon + 1);
+        semicolon = value.find(';');
+
+        std::string_view param = trim(value.substr(0, semicolon));
+        size_t equal = param.find('=');
+        std::string_view key = trim(param.substr(0, equal));
+        std::string_view data = (std::string_view::npos == equal) ? std::string_view() : trim(param.substr(equal + 1));
+        if (EqualsNoCase(key, "multicast"))
+        {
+            transport.multicast = true;
+        }
+        else if (EqualsNoCase(key, "source"))
+        {
+            transport.source = data;
+        }
+        else if (EqualsNoCase(key, "destination"))
+        {
+            transport.destination = data;
+        }
+        else if (EqualsNoCase(key, "server_port"))
+        {
+            toRange(data, transport.server_rtp_port, transport.server_rtcp_port, 1);
+        }
+        else if (EqualsNoCase(key, "client_port"))
+        {
+            toRange(data, transport.client_rtp_port, transport.client_rtcp_port, 1);
+        }
+        else if (EqualsNoCase(key, "port"))
+        {
+            toRange(data, transport.port, transport.rtcp_port, 1);
+        }
+        else if (EqualsNoCase(key, "interleaved"))
+        {
+            toRange(data, transport.rtp_channel, transport.rtcp_channel, 1);
+        }
+        else if (EqualsNoCase(key, "ttl"))
+        {
+            toInt(data, transport.ttl);
+        }
+    }
+    return 0;
+}
+
+int RtspResponse::GetChallenge(Challenge& challenge) const
+{
+    challenge = Challenge();
+    for (int i = 0; i < _header_count; ++i)
+    {
+        Challenge candidate;
+        if (EqualsNoCase(_headers[i].name, "WWW-Authenticate") &&
+            parseChallenge(_headers[i].value, candidate) == 0 && candidate.scheme > challenge.scheme)
+        {
+            challenge = candidate;
+        }
+    }
+    return (Challenge::SCHEME_NONE == challenge.scheme) ? -1 : 0;
+}
+
+bool RtspResponse::EqualsNoCase(std::string_view lhs, std::string_view rhs)
+{
+    if (lhs.size() != rhs.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < lhs.size(); ++i)
+    {
+        if (tolower((unsigned char)lhs[i]) != tolower((unsigned char)rhs[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t RtspResponse::HeaderLength(std::string_view message)
+{
+    // every line break followed by an empty line, CRLF or LF each
+    for (size_t eol = message.find('\n'); std::string_view::npos != eol; eol = message.find('\n', eol + 1))
+    {
+        size_t next = eol + 1;
+        if (next < message.size() && message[next] == '\r')
+        {
+            ++next;
+        }
+        if (next < message.size() && message[next] == '\n')
+        {
+            return next + 1;
+        }
+    }
+    return 0;
+}
+
+size_t RtspResponse::MessageLength(std::string_view message)
+{
+    size_t header_length = HeaderLength(message);
+    if (0 == header_length)
+    {
+        return 0;
+    }
+
+    // the start line never names Content-Length, so it needs no special case; a broken length means no body
+    size_t content_length = 0;
+    std::string_view headers = message.substr(0, header_length);
+    for (size_t off = 0, eol = 0; off < headers.size(); off = eol + 1)
+    {
+        eol = headers.find('\n', off);
+        std::string_view line = headers.substr(off, eol - off);
+        size_t colon = line.find(':');
+        if (std::string_view::npos == colon || !EqualsNoCase(trim(line.substr(0, colon)), "Content-Length"))
+        {
+            continue;
+        }
+
+        std::string_view value = trim(line.substr(colon + 1));
+        size_t length = 0;
+        std::from_chars_result result = std::from_chars(value.data(), value.data() + value.size(), length);
+        if (!value.empty() && result.ec == std::errc() && result.ptr == value.data() + value.size())
+        {
+            content_length = length;
+        }
+        break;
+    }
+
+    if (content_length > message.size() - header_length)
+    {
+        return 0;
+    }
+    return header_length + content_length;
+}
+
+std::string_view RtspResponse::trim(std::string_view value)
+{
+    size_t begin = value.find_first_not_of(" \t\r\n");
+    if (std::string_view::npos == begin)
+    {
+        return std::string_view();
+    }
+    size_t end = value.find_last_not_of(" \t\r\n");
+    return value.substr(begin, end - begin + 1);
+}
+
+bool RtspResponse::toInt(std::string_view value, int& number)
+{
+    int parsed = 0;
+    std::from_chars_result result = std::from_chars(value.data(), value.data() + value.size(), parsed);
+    if (value.empty() || result.ec != std::errc())
+    {
+        return false;
+    }
+    number = parsed;
+    return true;
+}
+
+void RtspResponse::toRange(std::string_view value, int& first, int& second, int step)
+{
+    // "6970-6971", a single number implies the next one
+    size_t dash = value.find('-');
+    if (toInt(trim(value.substr(0, dash)), first))
+    {
+        if (std::string_view::npos == dash || !toInt(trim(value.substr(dash + 1)), second))
+        {
+            second = first + step;
+        }
+    }
+}
+
+int RtspResponse::parseChallenge(std::string_view value, Challenge& challenge)
+{
+    // Digest realm="camera", nonce="8a3d...", stale=FALSE
+    size_t space = value.find_first_of(" \t");
+    std::string_view scheme = value.substr(0, space);
+    if (EqualsNoCase(scheme, "Digest"))
+    {
+        challenge.scheme = Challenge::SCHEME_DIGEST;
+    }
+    else if (EqualsNoCase(scheme, "Basic"))
+    {
+        challenge.scheme = Challenge::SCHEME_BASIC;
+    }
+    else
+    {
+        return -1;
+    }
+
+    size_t off = (std::string_view::npos == space) ? value.size() : space;
+    while (off < value.size())
+    {
+        off = value.find_first_not_of(" \t,", off);
+        if (std::string_view::npos == off)
+        {
+            break;
+        }
+
+        size_t equal = value.find_first_of("=,", off);
+        if (std::string_view::npos == equal || value[equal] == ',')
+        {
+            off = equal;
+            continue;
+        }
+        std::string_view key = trim(value.substr(off, equal - off));
+
+        // a quoted value may hold commas of its own
+        std::string_view data;
+        off = value.find_first_not_of(" \t", equal + 1);
+        if (std::string_view::npos == off)
+        {
+            break;
+        }
+        if (value[off] == '"')
+        {
+            size_t quote = value.find('"', off + 1);
+            if (std::string_view::npos == quote)
+            {
+                return -1;
+            }
+            data = value.substr(off + 1, quote - off - 1);
+            off = quote + 1;
+        }
+        else
+        {
+            size_t comma = value.find(',', off);
+            data = trim(value.substr(off, comma - off));
+            off = comma;
+        }
+
+        if (EqualsNoCase(key, "realm"))
+        {
+            challenge.realm = data;
+        }
+        else if (EqualsNoCase(key, "nonce"))
+        {
+            challenge.nonce = data;
+        }
+    }
+
+    // a digest answer is computed from the nonce
+    return (Challenge::SCHEME_DIGEST == challenge.scheme && challenge.nonce.empty()) ? -1 : 0;
+}
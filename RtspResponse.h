@@ -0,0 +1,143 @@
+
+/*****************************************************************************
+*                                                                            *
+*  @file     RtspResponse.h                                                  *
+*  @brief    RTSP reply parser declaration (RFC2326)                         *
+*                                                                            *
+*  Details.                                                                  *
+*    One pass over the reply splits status line and headers into views of    *
+*    the reply itself, the fields the client needs are parsed from those     *
+*    views on request. Nothing is allocated, the reply must outlive it.      *
+*                                                                            *
+*----------------------------------------------------------------------------*
+*  Remark   :                                                                *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef __RTSP_RESPONSE_HEADER_H__
+#define __RTSP_RESPONSE_HEADER_H__
+
+#include <string_view>
+
+#include <stddef.h>
+
+// headers beyond this are ignored, replies carry about a dozen
+#define RTSP_RESPONSE_MAX_HEADERS   32
+
+class RtspResponse
+{
+public:
+    struct Header
+    {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    /* The first transport of a Transport header */
+    struct Transport
+    {
+        std::string_view spec;          // e.g. "RTP/AVP/TCP"
+        bool multicast = false;
+        std::string_view source;
+        std::string_view destination;
+        int server_rtp_port = 0;
+        int server_rtcp_port = 0;
+        int client_rtp_port = 0;
+        int client_rtcp_port = 0;
+        int port = 0;                   // multicast
+        int rtcp_port = 0;
+        int rtp_channel = -1;           // interleaved
+        int rtcp_channel = -1;
+        int ttl = 0;
+    };
+
+    struct Challenge
+    {
+        enum Scheme
+        {
+            SCHEME_NONE = 0,
+            SCHEME_BASIC,
+            SCHEME_DIGEST
+        };
+
+        Scheme scheme = SCHEME_NONE;
+        std::string_view realm;
+        std::string_view nonce;
+    };
+
+public:
+    RtspResponse();
+
+    /* Parse the status line and headers of 'message', whose bytes must stay untouched while the response is used.
+    * return:
+    *    -1 if it does not start with an RTSP status line or the header block is incomplete
+    * */
+    int Parse(std::string_view message);
+
+    inline int GetStatus() const { return _status; }
+    inline std::string_view GetReason() const { return _reason; }
+
+    /* Value of the first header named 'name', compared case-insensitively, empty if there is none */
+    std::string_view GetHeader(std::string_view name) const;
+
+    inline int GetHeaderCount() const { return _header_count; }
+    inline const Header& GetHeader(int index) const { return _headers[index]; }
+
+    /* return:
+    *    -1 without a valid Content-Length header
+    * */
+    long long GetContentLength() const;
+
+    /* Whatever of the body followed the header block in the parsed message */
+    inline std::string_view GetBody() const { return _body; }
+
+    /* Session header, timeout is 0 if the server named none.
+    * return:
+    *    -1 without a Session header
+    * */
+    int GetSession(std::string_view& id, int& timeout) const;
+
+    /* return:
+    *    -1 without a Transport header
+    * */
+    int GetTransport(Transport& transport) const;
+
+    /* The strongest of the WWW-Authenticate challenges, Digest before Basic.
+    * return:
+    *    -1 without a challenge this client can answer
+    * */
+    int GetChallenge(Challenge& challenge) const;
+
+    static bool EqualsNoCase(std::string_view lhs, std::string_view rhs);
+
+    /* Length of the header block at the start of 'message', the empty line ending it included.
+    * Lines may end with CRLF or a bare LF, like Parse accepts them.
+    * return:
+    *    0 while the block is incomplete
+    * */
+    static size_t HeaderLength(std::string_view message);
+
+    /* Length of the whole message at the start of 'message', header block and Content-Length body.
+    * Framed the same for replies and for requests from the server, whatever the start line says,
+    * and without the RTSP_RESPONSE_MAX_HEADERS limit of Parse.
+    * return:
+    *    0 while the message is incomplete
+    * */
+    static size_t MessageLength(std::string_view message);
+
+private:
+    static std::string_view trim(std::string_view value);
+    static bool toInt(std::string_view value, int& number);
+    static void toRange(std::string_view value, int& first, int& second, int step);
+    static int parseChallenge(std::string_view value, Challenge& challenge);
+
+private:
+    int _status;
+    std::string_view _reason;
+    std::string_view _body;
+
+    Header _headers[RTSP_RESPONSE_MAX_HEADERS];
+    int _header_count;
+};
+
+#endif
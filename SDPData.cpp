@@ -14,9 +14,10 @@
 //
 
 #include "SDPData.h"
+#include "MulticastGroup.h"
+#include "RtspResponse.h"
 
-#include <regex>
-#include <sstream>
+#include <charconv>
 
 SDPData::SDPData()
     : _sdp_version(0)
@@ -37,159 +38,243 @@ SDPData::~SDPData()
 {
 }
 
+/* Next whitespace separated field of 'rest', which is advanced past it */
+static std::string_view nextField(std::string_view& rest)
+{
+    size_t begin = rest.find_first_not_of(" \t");
+    if (std::string_view::npos == begin)
+    {
+        rest = std::string_view();
+        return rest;
+    }
+    size_t end = rest.find_first_of(" \t", begin);
+    std::string_view field = rest.substr(begin, end - begin);
+    rest = (std::string_view::npos == end) ? std::string_view() : rest.substr(end);
+    return field;
+}
+
+static int toInt(std::string_view value)
+{
+    int number = 0;
+    std::from_chars(value.data(), value.data() + value.size(), number);
+    return number;
+}
+
+/* Locale independent, atof would stop at the '.' of "npt=12.5" under a decimal comma locale */
+static double toDouble(std::string_view value)
+{
+    size_t begin = value.find_first_not_of(" \t");
+    double number = 0.0;
+    if (std::string_view::npos != begin)
+    {
+        std::from_chars(value.data() + begin, value.data() + value.size(), number);
+    }
+    return number;
+}
+
+/* 'value' without its "name:" prefix if it is the attribute 'name' */
+static bool matchAttribute(std::string_view value, std::string_view name, std::string_view& rest)
+{
+    if (value.size() < name.size() || value.compare(0, name.size(), name) != 0 ||
+        (value.size() > name.size() && value[name.size()] != ':'))
+    {
+        return false;
+    }
+    rest = (value.size() > name.size()) ? value.substr(name.size() + 1) : std::string_view();
+    return true;
+}
+
+static void assignField(std::string& target, std::string_view field)
+{
+    target.assign(field.data(), field.size());
+}
+
 void SDPData::Parse(const std::string &sdp)
 {
-    static const std::regex key_value_pattern("([a-zA-Z])=(.*)");
+    // <type>=<value> lines, ended by CRLF or a bare LF
+    std::string_view text(sdp);
+    Media* media = nullptr;
+    size_t media_index = 0;
 
-    int media_index = -1;
-    for (std::string::size_type off = 0, pos = sdp.find("\r\n"); pos != std::string::npos; pos = sdp.find("\r\n", off))
+    // a repeated DESCRIBE must not inherit the fallbacks of the previous description
+    _session.source_filter.clear();
+    _session.connection = Network();
+    _session.bandwidth = 0;
+    _session.range = Range();
+    for (size_t off = 0; off < text.size();)
     {
-        std::smatch matchs;
-        const std::string& line = sdp.substr(off, pos - off);
-        if (std::regex_match(line, matchs, key_value_pattern))
-        {
-            if ("v" == matchs[1].str())
-            {
-                _sdp_version = atoi(matchs[2].str().c_str());
-            } 
-            else if ("e" == matchs[1].str())
-            {
-                _owner.email = matchs[2].str();
-            }
-            else if ("s" == matchs[1].str())
-            {
-                _session.name = matchs[2].str();
-            }
-            else if ("i" == matchs[1].str())
-            {
-                _session.information = matchs[2].str();
-            }
-            else if ("t" == matchs[1].str())
-            {
-                std::istringstream spliter(matchs[2].str());
-                std::vector<std::string> objs((std::istream_iterator<std::string>(spliter)), std::istream_iterator<std::string>());
+        size_t eol = text.find('\n', off);
+        std::string_view line = text.substr(off, (std::string_view::npos == eol) ? std::string_view::npos : eol - off);
+        off = (std::string_view::npos == eol) ? text.size() : eol + 1;
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        if (line.size() < 2 || line[1] != '=')
+        {
+            continue;
+        }
 
-                _session.time.start = atof(objs[0].c_str());
-                _session.time.stop = atof(objs[1].c_str());
-            }
-            else if("o" == matchs[1].str())
+        std::string_view value = line.substr(2);
+        switch (line[0])
+        {
+        case 'v':
+            _sdp_version = toInt(value);
+            break;
+        case 'e':
+            assignField(_owner.email, value);
+            break;
+        case 's':
+            assignField(_session.name, value);
+            break;
+        case 'i':
+            if (!media)
             {
-                std::istringstream spliter(matchs[2].str());
-                std::vector<std::string> objs((std::istream_iterator<std::string>(spliter)), std::istream_iterator<std::string>());
-
-                switch (objs.size())
-                {
-                case 6:
-                    _owner.network.address = objs[5];
-                case 5:
-                    _owner.network.addr_type = objs[4];
-                case 4:
-                    _owner.network.net_type = objs[3];
-                case 3:
-                    _owner.ver = objs[2];
-                case 2:
-                    _owner.id = objs[1];
-                case 1:
-                    _owner.owner = objs[0];
-                default:
-                    break;
-                }
+                assignField(_session.information, value);
             }
-            else if ("m" == matchs[1].str())
+            break;
+        case 't':
+            _session.time.start = toDouble(nextField(value));
+            _session.time.stop = toDouble(nextField(value));
+            break;
+        case 'o':
+            // <username> <sess-id> <sess-version> <nettype> <addrtype> <unicast-address>
+            assignField(_owner.owner, nextField(value));
+            assignField(_owner.id, nextField(value));
+            assignField(_owner.ver, nextField(value));
+            assignField(_owner.network.net_type, nextField(value));
+            assignField(_owner.network.addr_type, nextField(value));
+            assignField(_owner.network.address, nextField(value));
+            break;
+        case 'm':
+        {
+            // a DESCRIBE again updates the media in place, what SETUP negotiated for them stays
+            if (_session.media_array.size() <= media_index)
             {
-                media_index++;
-
-                std::istringstream spliter(matchs[2].str());
-                std::vector<std::string> objs((std::istream_iterator<std::string>(spliter)), std::istream_iterator<std::string>());
-
-                if (_session.media_array.size() <= media_index)
-                {
-                    _session.media_array.push_back(Media{});
-                }
-
-                Media& media = _session.media_array[media_index];
-                media.type = objs[0];
-                switch (objs.size())
-                {
-                case 4:
-                    media.format = atoi(objs[3].c_str());
-                case 3:
-                    media.transport = objs[2];
-                case 2:
-                    media.port = (unsigned short)atoi(objs[1].c_str());
-                default:
-                    break;
-                }
+                _session.media_array.push_back(Media{});
             }
-            else if ("a" == matchs[1].str())
+            media = &_session.media_array[media_index++];
+            media->codec.clear();
+            media->fmtp.clear();
+            media->control.clear();
+            media->source_filter.clear();
+            media->framerate = 0.0;
+            media->bandwidth = 0;
+            media->range = Range();
+            media->connection = Network();
+
+            // <media> <port>[/<count>] <proto> <fmt> ...
+            assignField(media->type, nextField(value));
+            media->port = (unsigned short)toInt(nextField(value));
+            assignField(media->transport, nextField(value));
+            media->format = toInt(nextField(value));
+            break;
+        }
+        case 'c':
+        {
+            // <nettype> <addrtype> <connection-address>
+            Network& connection = media ? media->connection : _session.connection;
+            assignField(connection.net_type, nextField(value));
+            assignField(connection.addr_type, nextField(value));
+            assignField(connection.address, nextField(value));
+            break;
+        }
+        case 'b':
+        {
+            // <bwtype>:<bandwidth>, AS in kbit/s, TIAS in bit/s
+            size_t colon = value.find(':');
+            if (std::string_view::npos != colon)
             {
-                std::string value = matchs[2].str();
-                if (_session.media_array.empty())
+                std::string_view type = value.substr(0, colon);
+                int bandwidth = toInt(value.substr(colon + 1));
+                if ("TIAS" == type)
                 {
-                    if (value.find("control") == (std::string::size_type)0)
-                    {
-                        _session.control = value.substr(8);
-                    }
-                    else if (value.find("tool") == (std::string::size_type)0)
-                    {
-                        _session.tool = value.substr(5);
-                    }
-                    else if (value.find("type") == (std::string::size_type)0)
-                    {
-                        _session.type = value.substr(5);
-                    }
+                    bandwidth /= 1000;
                 }
-                else
+                else if ("AS" != type)
                 {
-                    Media& media = _session.media_array[media_index];
-
-                    if (value.find("rtpmap") == (std::string::size_type)0)
-                    {
-                        std::istringstream spliter(value.substr(6));
-                        std::vector<std::string> objs((std::istream_iterator<std::string>(spliter)), std::istream_iterator<std::string>());
-                        std::string::size_type p = objs[1].find('/');
-                        if (std::string::npos == p)
-                        {
-                            media.codec = objs[1];
-                        }
-                        else
-                        {
-                            media.codec = objs[1].substr(0, p);
-                            media.time_rate = atoi(objs[1].substr(p + 1).c_str());
-                        }
-                    }
-                    else if (value.find("control") == (std::string::size_type)0)
-                    {
-                        media.control = value.substr(8);
-                    }
-                }
-            }
-            else if ("c" == matchs[1].str() && media_index < _session.media_array.size())
-            {
-                std::istringstream spliter(matchs[2].str());
-                std::vector<std::string> objs((std::istream_iterator<std::string>(spliter)), std::istream_iterator<std::string>());
-
-                Media& media = _session.media_array[media_index];
-                switch (objs.size())
-                {
-                case 3:
-                    media.connection.address = objs[2];
-                case 2:
-                    media.connection.addr_type = objs[1];
-                case 1:
-                    media.connection.net_type = objs[0];
-                default:
-                    break;
+                    break;
                 }
+                (media ? media->bandwidth : _session.bandwidth) = bandwidth;
             }
-            else
-            {
-            }
+            break;
+        }
+        case 'a':
+            parseAttribute(value, media);
+            break;
+        default:
+            break;
         }
-        off = pos + 2;
     }
 }
 
+void SDPData::parseAttribute(std::string_view value, Media* media)
+{
+    std::string_view rest;
+    if (!media)
+    {
+        if (matchAttribute(value, "control", rest))
+        {
+            assignField(_session.control, rest);
+        }
+        else if (matchAttribute(value, "tool", rest))
+        {
+            assignField(_session.tool, rest);
+        }
+        else if (matchAttribute(value, "type", rest))
+        {
+            assignField(_session.type, rest);
+        }
+        else if (matchAttribute(value, "source-filter", rest))
+        {
+            _session.source_filter = parseSourceFilter(rest);
+        }
+        else if (matchAttribute(value, "range", rest))
+        {
+            _session.range = parseRange(rest);
+        }
+        return;
+    }
+
+    if (matchAttribute(value, "rtpmap", rest))
+    {
+        // <payload type> <encoding name>/<clock rate>[/<encoding parameters>]
+        nextField(rest);
+        std::string_view encoding = nextField(rest);
+        size_t slash = encoding.find('/');
+        assignField(media->codec, encoding.substr(0, slash));
+        if (std::string_view::npos != slash)
+        {
+            media->time_rate = toInt(encoding.substr(slash + 1));
+        }
+    }
+    else if (matchAttribute(value, "fmtp", rest))
+    {
+        // <format> <parameters>
+        nextField(rest);
+        size_t begin = rest.find_first_not_of(" \t");
+        if (std::string_view::npos != begin)
+        {
+            assignField(media->fmtp, rest.substr(begin));
+        }
+    }
+    else if (matchAttribute(value, "control", rest))
+    {
+        assignField(media->control, rest);
+    }
+    else if (matchAttribute(value, "framerate", rest))
+    {
+        media->framerate = toDouble(rest);
+    }
+    else if (matchAttribute(value, "range", rest))
+    {
+        media->range = parseRange(rest);
+    }
+    else if (matchAttribute(value, "source-filter", rest))
+    {
+        media->source_filter = parseSourceFilter(rest);
+    }
+}
 
 void SDPData::ParseMediaRtpPort(const std::string& media_type, unsigned short rtp_port, unsigned short rtcp_port)
 {
@@ -204,77 +289,73 @@ void SDPData::ParseMediaRtpPort(const std::string& media_type, unsigned short rt
     }
 }
 
-void SDPData::ParseMediaSessionInfomation(const std::string& media_type, const std::string &setup_response)
+void SDPData::ParseMediaChannels(const std::string& media_type, int rtp_channel, int rtcp_channel)
 {
-    static const std::regex session_id_timeout_pattern("Session:([ ]+)([0-9a-fA-F]+);timeout=([0-9]+)");
-    static const std::regex session_id_pattern("Session:([ ]+)([0-9a-fA-F]+);*");
-
-    static const std::regex trasnport_info_pattern("Transport:([ ]+)(.+)");
-
-    size_t media_index = 0;
-    while (media_index < _session.media_array.size())
+    for (Media& media : _session.media_array)
     {
-        if (media_type == _session.media_array[media_index].type)
+        if (media_type == media.type)
         {
+            media.rtp_channel = rtp_channel;
+            media.rtcp_channel = rtcp_channel;
             break;
         }
-        ++media_index;
+    }
+}
+
+void SDPData::ParseMediaSessionInfomation(const std::string& media_type, const std::string &setup_response)
+{
+    RtspResponse response;
+    if (response.Parse(setup_response) < 0)
+    {
+        return;
     }
 
-    if (media_index < _session.media_array.size())
+    for (Media& media : _session.media_array)
     {
-        for (std::string::size_type off = 0, pos = setup_response.find("\r\n"); pos != std::string::npos; pos = setup_response.find("\r\n", off))
+        if (media_type != media.type)
+        {
+            continue;
+        }
+
+        std::string_view session;
+        int timeout = 0;
+        if (response.GetSession(session, timeout) == 0)
+        {
+            media.session.assign(session.data(), session.size());
+            media.timeout = (timeout > 0) ? timeout : 30;
+        }
+
+        RtspResponse::Transport transport;
+        if (response.GetTransport(transport) == 0)
         {
-            std::smatch matchs;
-            const std::string& line = setup_response.substr(off, pos - off);
-            if (std::regex_match(line, matchs, session_id_timeout_pattern))
+            if (!transport.source.empty())
             {
-                _session.media_array[media_index].session = matchs[2].str();
-                _session.media_array[media_index].timeout = atoi(matchs[3].str().c_str());
-                break;
+                media.server.address.assign(transport.source.data(), transport.source.size());
             }
-            else if (std::regex_match(line, matchs, session_id_pattern))
+            if (transport.server_rtp_port > 0)
             {
-                _session.media_array[media_index].session = matchs[2].str();
-                _session.media_array[media_index].timeout = 30;
-                break;
+                media.server.rtp_port = (unsigned short)transport.server_rtp_port;
+                media.server.rtcp_port = (unsigned short)transport.server_rtcp_port;
             }
-            else if (std::regex_match(line, matchs, trasnport_info_pattern))
+            if (transport.rtp_channel >= 0)
             {
-                std::istringstream stream_spliter(matchs[2].str());
-                std::string token;
-                while (std::getline(stream_spliter, token, ';')) 
-                {
-                    std::string::size_type pos = token.find('=');
-                    if (std::string::npos != pos)
-                    {
-                        std::string tkey = token.substr(0, pos);
-                        if ("source" == tkey)
-                        {
-                            _session.media_array[media_index].server.address = token.substr(pos + 1);
-                        }
-                        else if ("server_port" == tkey)
-                        {
-                            std::string port_range = token.substr(pos + 1);
-
-                            std::string::size_type p = port_range.find('-');
-                            if (std::string::npos != p)
-                            {
-                                _session.media_array[media_index].server.rtp_port = (unsigned short)atoi(port_range.substr(0, p).c_str());
-                                _session.media_array[media_index].server.rtcp_port = (unsigned short)atoi(port_range.substr(p + 1).c_str());
-                            }
-                            else
-                            {
-                                _session.media_array[media_index].server.rtp_port = (unsigned short)atoi(port_range.substr(0, p).c_str());
-                                _session.media_array[media_index].server.rtcp_port = _session.media_array[media_index].server.rtp_port + 1;
-                            }
-                        }
-                    }
-                }
-                break;
+                media.rtp_channel = transport.rtp_channel;
+                media.rtcp_channel = transport.rtcp_channel;
+            }
+
+            // multicast ports are the same for every receiver of the group
+            media.multicast = transport.multicast;
+            if (!transport.destination.empty())
+            {
+                media.group.address.assign(transport.destination.data(), transport.destination.size());
+            }
+            if (transport.port > 0)
+            {
+                media.group.rtp_port = (unsigned short)transport.port;
+                media.group.rtcp_port = (unsigned short)transport.rtcp_port;
             }
-            off = pos + 2;
         }
+        break;
     }
 }
 
@@ -348,3 +429,82 @@ std::string SDPData::GetMediaSessionID(const std::string& media_type)
     }
     return session;
 }
+
+int SDPData::GetMediaMulticast(const std::string& media_type, MulticastEndpoint& multicast)
+{
+    for (const Media& media : _session.media_array)
+    {
+        if (media_type == media.type)
+        {
+            if (!media.multicast)
+            {
+                return -1;
+            }
+
+            // c=IN IP4 <group>/<ttl>[/<count>]
+            multicast.group = media.group.address;
+            if (multicast.group.empty())
+            {
+                const std::string& address = media.connection.address.empty() ? _session.connection.address : media.connection.address;
+                multicast.group = address.substr(0, address.find('/'));
+            }
+
+            multicast.rtp_port = media.group.rtp_port;
+            multicast.rtcp_port = media.group.rtcp_port;
+            if (multicast.rtp_port == 0)
+            {
+                multicast.rtp_port = media.port;
+                multicast.rtcp_port = media.port + 1;
+            }
+
+            // a source-specific group is only delivered for a named sender, the SDP names it or the server sends itself
+            multicast.source = media.source_filter.empty() ? _session.source_filter : media.source_filter;
+            if (multicast.source.empty() && MulticastGroup::IsSourceSpecific(multicast.group))
+            {
+                multicast.source = media.server.address;
+            }
+            return (multicast.group.empty() || multicast.rtp_port == 0) ? -1 : 0;
+        }
+    }
+    return -1;
+}
+
+std::string SDPData::parseSourceFilter(std::string_view value)
+{
+    // incl IN IP4 <destination> <source> [<source> ...], RFC4570
+    if (nextField(value) != "incl")
+    {
+        return "";
+    }
+    nextField(value);
+    nextField(value);
+    nextField(value);
+
+    std::string source;
+    assignField(source, nextField(value));
+    return source;
+}
+
+SDPData::Range SDPData::parseRange(std::string_view value)
+{
+    // npt=<start>-[<end>], "now" starts a live stream, other time formats are not used by cameras
+    Range range;
+    size_t equal = value.find('=');
+    if (std::string_view::npos == equal || value.substr(0, equal) != "npt")
+    {
+        return range;
+    }
+
+    value = value.substr(equal + 1);
+    size_t dash = value.find('-');
+    std::string_view start = value.substr(0, dash);
+    if (start != "now")
+    {
+        range.start = toDouble(start);
+    }
+    if (std::string_view::npos != dash && dash + 1 < value.size())
+    {
+        range.end = toDouble(value.substr(dash + 1));
+    }
+    return range;
+}
@@ -19,6 +19,7 @@
 #include <Common.h>
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 class SDPData
@@ -31,6 +32,13 @@ public:
         std::string address;
     } Network;
 
+    /* a=range:npt=<start>-[<end>], RFC2326.C.1.5 */
+    typedef struct _Range
+    {
+        double start = 0.0;
+        double end = -1.0;      // -1: open ended, a live stream
+    } Range;
+
     typedef struct _Media
     {
         std::string type;
@@ -40,7 +48,11 @@ public:
         std::string transport;
         std::string codec;
         int time_rate;
+        std::string fmtp;   // a=fmtp parameters, e.g. "mode=AAC-hbr;sizelength=13"
         int format = 0; // media format: DynamicRTP-Type-XX
+        double framerate = 0.0;     // a=framerate, 0 if not announced
+        int bandwidth = 0;          // b=AS in kbit/s, 0 if not announced
+        Range range;
 
         std::string session;
         int timeout = 0;
@@ -48,7 +60,16 @@ public:
         Endpoint client;
         Endpoint server;
 
+        // RTP over the RTSP connection
+        int rtp_channel = -1;
+        int rtcp_channel = -1;
+
         Network connection;
+        std::string source_filter;  // a=source-filter incl, the sender of a source-specific group
+
+        // multicast transport granted by SETUP
+        bool multicast = false;
+        Endpoint group;             // destination, ports
     } Media;
 
     typedef std::vector<Media> MediaArray;
@@ -79,6 +100,12 @@ public:
         std::string control;
 
         std::string action;
+        std::string source_filter;  // session level, for media without one of their own
+
+        // session level, for media without their own
+        Network connection;
+        int bandwidth = 0;
+        Range range;
 
         ActiveTime time;
         
@@ -94,12 +121,15 @@ public:
     void Parse(const std::string &sdp);
 
     void ParseMediaRtpPort(const std::string& media_type, unsigned short rtp_port, unsigned short rtcp_port);
+    void ParseMediaChannels(const std::string& media_type, int rtp_channel, int rtcp_channel);
     void ParseMediaSessionInfomation(const std::string& media_type, const std::string &setup_response);
 
     inline int GetSdpVersion() {   return _sdp_version;    }
 
     inline const std::string& GetSessionName() { return _session.name; }
     std::string GetSessionControlUri(const std::string& base);
+    inline const SDPData::Range& GetSessionRange() { return _session.range; }
+    inline int GetSessionBandwidth() { return _session.bandwidth; }
 
     inline const SDPData::MediaArray& GetMedia() { return _session.media_array; }
 
@@ -107,6 +137,17 @@ public:
     std::string GetMediaTransport(const std::string& media_type);
     std::string GetMediaSessionID(const std::string& media_type);
 
+    /* Group, ports and source of a media set up as multicast, the SDP fills in what the SETUP reply left out.
+    * return:
+    *    -1 if the media was not set up as multicast
+    * */
+    int GetMediaMulticast(const std::string& media_type, MulticastEndpoint& multicast);
+
+private:
+    void parseAttribute(std::string_view value, Media* media);
+    static std::string parseSourceFilter(std::string_view value);
+    static Range parseRange(std::string_view value);
+
 private:
     /* RFC2327.6 */
     int _sdp_version;
@@ -0,0 +1,147 @@
+
+/*****************************************************************************
+*                                                                            *
+*  @file     SpscRing.h                                                      *
+*  @brief    Bounded single-producer/single-consumer ring buffer             *
+*                                                                            *
+*  Details.                                                                  *
+*    Push is only called from one thread and Pop only from one other         *
+*    thread, neither side ever takes a lock. The producer may also Evict     *
+*    the oldest item to make room, every slot carries a sequence number so   *
+*    an item is claimed by exactly one side.                                 *
+*                                                                            *
+*----------------------------------------------------------------------------*
+*  Remark   :                                                                *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef __SPSC_RING_HEADER_H__
+#define __SPSC_RING_HEADER_H__
+
+#include <atomic>
+#include <vector>
+
+#include <stddef.h>
+
+#define SPSC_CACHE_LINE     64
+
+template <typename T>
+class SpscRing
+{
+public:
+    /* capacity is rounded up to a power of two */
+    explicit SpscRing(size_t capacity = 1024)
+        : _cells(), _mask(0), _head(0), _tail(0)
+    {
+        Reset(capacity);
+    }
+
+    /* Not thread safe, only while neither side is running */
+    void Reset(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        _cells = std::vector<Cell>(size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        _mask = size - 1;
+        _head.store(0, std::memory_order_relaxed);
+        _tail.store(0, std::memory_order_relaxed);
+    }
+
+    /* producer side, false when the ring is full */
+    bool Push(const T& item)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        Cell& cell = _cells[tail & _mask];
+
+        // a slot is free again once its claimer moved the sequence a lap ahead
+        if (cell.sequence.load(std::memory_order_acquire) != tail)
+        {
+            return false;
+        }
+        cell.item = item;
+        cell.sequence.store(tail + 1, std::memory_order_release);
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* consumer side, false when the ring is empty. The item is moved out of the ring */
+    inline bool Pop(T& item) { return claim(item); }
+
+    /* producer side, take the oldest item out to make room, false when the consumer got to everything first */
+    inline bool Evict(T& item) { return claim(item); }
+
+    /* approximate unless called from one of the two sides */
+    bool Empty() const
+    {
+        return Size() == 0;
+    }
+
+    size_t Size() const
+    {
+        size_t head = _head.load(std::memory_order_acquire);
+        size_t tail = _tail.load(std::memory_order_acquire);
+        return (tail > head) ? tail - head : 0;
+    }
+
+    size_t Capacity() const
+    {
+        return _mask + 1;
+    }
+
+private:
+    bool claim(T& item)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell& cell = _cells[head & _mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            if (sequence == head + 1)
+            {
+                if (_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed))
+                {
+                    item = cell.item;
+                    cell.sequence.store(head + _mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (sequence == head)
+            {
+                // not pushed yet
+                return false;
+            }
+            else
+            {
+                // the other side claimed it first
+                head = _head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    std::vector<Cell> _cells;
+    size_t _mask;
+
+    // indexes grow forever and are masked on access, each on its own cache line
+    alignas(SPSC_CACHE_LINE) std::atomic<size_t> _head;
+    alignas(SPSC_CACHE_LINE) std::atomic<size_t> _tail;
+
+private:
+    SpscRing(const SpscRing& rhs);
+    SpscRing& operator=(const SpscRing& rhs);
+};
+
+#endif
@@ -0,0 +1,326 @@
+
+#include "UdpReceiver.h"
+
+#include <sys/types.h>
+#ifndef _MSC_VER
+#include <sys/socket.h>
+#ifdef __linux__
+#include <linux/sock_diag.h>
+#endif
+#include <unistd.h>
+#include <fcntl.h>
+#define closesocket close
+#endif
+#include <string.h>
+#include <errno.h>
+
+#define Close_Socket(fd) if(fd != INVALID_SOCKET) { closesocket(fd); fd = INVALID_SOCKET; }
+
+static void prepareUdpSocket(SOCKET fd)
+{
+#ifdef SO_RXQ_OVFL
+    // every datagram then carries the socket's drop count
+    int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable));
+#endif
+
+#ifdef _MSC_VER
+    u_long nonblock = 1;
+    ioctlsocket(fd, FIONBIO, &nonblock);
+#else
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+static SOCKET bindUdpSocket(unsigned short port)
+{
+    SOCKET fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd == INVALID_SOCKET)
+    {
+        return INVALID_SOCKET;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        Close_Socket(fd);
+        return INVALID_SOCKET;
+    }
+
+    prepareUdpSocket(fd);
+    return fd;
+}
+
+UdpReceiver::UdpReceiver()
+    : _rtp_socket(INVALID_SOCKET), _rtcp_socket(INVALID_SOCKET)
+    , _locker(), _chunks(), _free(nullptr)
+    , _truncated(0), _rtp_overflow(0), _rtcp_overflow(0)
+{
+}
+
+UdpReceiver::~UdpReceiver()
+{
+    Destroy();
+
+    for (Datagram* chunk : _chunks)
+    {
+        delete[] chunk;
+    }
+}
+
+int UdpReceiver::Create(const Endpoint& client)
+{
+    if (_rtp_socket != INVALID_SOCKET)
+    {
+        return 0;
+    }
+
+    _rtp_socket = bindUdpSocket(client.rtp_port);
+    _rtcp_socket = bindUdpSocket(client.rtcp_port);
+    if (_rtp_socket == INVALID_SOCKET || _rtcp_socket == INVALID_SOCKET)
+    {
+        Destroy();
+        return -1;
+    }
+
+    // one batch up front, the pool only grows while the consumer holds on to datagrams, up to UDP_POOL_MAX_CHUNKS
+    Datagram* datagrams[UDP_RECV_BATCH];
+    release(datagrams, acquire(datagrams, UDP_RECV_BATCH));
+    return 0;
+}
+
+int UdpReceiver::Create(SOCKET rtp_socket, SOCKET rtcp_socket)
+{
+    if (_rtp_socket != INVALID_SOCKET || rtp_socket == INVALID_SOCKET || rtcp_socket == INVALID_SOCKET)
+    {
+        Close_Socket(rtp_socket);
+        Close_Socket(rtcp_socket);
+        return -1;
+    }
+
+    prepareUdpSocket(rtp_socket);
+    prepareUdpSocket(rtcp_socket);
+    _rtp_socket = rtp_socket;
+    _rtcp_socket = rtcp_socket;
+
+    Datagram* datagrams[UDP_RECV_BATCH];
+    release(datagrams, acquire(datagrams, UDP_RECV_BATCH));
+    return 0;
+}
+
+void UdpReceiver::Destroy()
+{
+    Close_Socket(_rtp_socket);
+    Close_Socket(_rtcp_socket);
+}
+
+int UdpReceiver::Receive(std::vector<Datagram*>& batch, std::vector<Datagram*>* rtcp)
+{
+    receive(_rtcp_socket, rtcp, _rtcp_overflow);
+    return receive(_rtp_socket, &batch, _rtp_overflow);
+}
+
+int UdpReceiver::SetReceiveBuffer(SOCKET fd, int bytes)
+{
+#ifdef SO_RCVBUFFORCE
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &bytes, sizeof(bytes)) < 0)
+#endif
+    {
+        // capped at net.core.rmem_max
+        if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, (const char*)&bytes, sizeof(bytes)) < 0)
+        {
+            return -1;
+        }
+    }
+
+    int granted = 0;
+    socklen_t length = sizeof(granted);
+    if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, (char*)&granted, &length) < 0)
+    {
+        return -1;
+    }
+    return granted;
+}
+
+long long UdpReceiver::GetSocketDrops(SOCKET fd)
+{
+#if defined(__linux__) && defined(SO_MEMINFO)
+    uint32_t meminfo[SK_MEMINFO_VARS];
+    socklen_t length = sizeof(meminfo);
+    if (getsockopt(fd, SOL_SOCKET, SO_MEMINFO, meminfo, &length) == 0 && length > SK_MEMINFO_DROPS * sizeof(uint32_t))
+    {
+        return meminfo[SK_MEMINFO_DROPS];
+    }
+#endif
+    return -1;
+}
+
+UdpReceiver::Datagram* UdpReceiver::Acquire()
+{
+    Datagram* datagram = nullptr;
+    if (acquire(&datagram, 1) == 0)
+    {
+        return nullptr;
+    }
+    datagram->size = 0;
+    return datagram;
+}
+
+void UdpReceiver::Release(Datagram* datagram)
+{
+    release(&datagram, 1);
+}
+
+int UdpReceiver::receive(SOCKET fd, std::vector<Datagram*>* batch, std::atomic<uint32_t>& overflow)
+{
+    Datagram* datagrams[UDP_RECV_BATCH];
+    int total = 0;
+    for (int round = 0; round < UDP_RECV_MAX_BATCHES; ++round)
+    {
+        int count = acquire(datagrams, UDP_RECV_BATCH);
+        if (count == 0)
+        {
+            break; // pool exhausted, the kernel queue holds the rest
+        }
+
+        int received = 0;
+#ifdef __linux__
+        struct mmsghdr msgs[UDP_RECV_BATCH];
+        struct iovec iovs[UDP_RECV_BATCH];
+        union
+        {
+            char buffer[CMSG_SPACE(sizeof(uint32_t))];
+            struct cmsghdr align;
+        } controls[UDP_RECV_BATCH];
+        memset(msgs, 0, sizeof(msgs[0]) * count);
+        for (int i = 0; i < count; ++i)
+        {
+            iovs[i].iov_base = datagrams[i]->data;
+            iovs[i].iov_len = UDP_DATAGRAM_SIZE;
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_control = controls[i].buffer;
+            msgs[i].msg_hdr.msg_controllen = sizeof(controls[i].buffer);
+        }
+
+        received = recvmmsg(fd, msgs, count, MSG_DONTWAIT, nullptr);
+#ifdef SO_RXQ_OVFL
+        if (received > 0)
+        {
+            // the counter is cumulative, the last datagram has the latest value
+            struct msghdr* last = &msgs[received - 1].msg_hdr;
+            for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(last); cmsg; cmsg = CMSG_NXTHDR(last, cmsg))
+            {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+                {
+                    uint32_t dropped = 0;
+                    memcpy(&dropped, CMSG_DATA(cmsg), sizeof(dropped));
+                    overflow.store(dropped, std::memory_order_relaxed);
+                }
+            }
+        }
+#endif
+        for (int i = 0; i < received; ++i)
+        {
+            if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+            {
+                ++_truncated;
+                datagrams[i]->size = 0;
+            }
+            else
+            {
+                datagrams[i]->size = (int)msgs[i].msg_len;
+            }
+        }
+#else
+        while (received < count)
+        {
+            int size = (int)recv(fd, (char*)datagrams[received]->data, UDP_DATAGRAM_SIZE, 0);
+            if (size < 0)
+            {
+                break;
+            }
+            datagrams[received++]->size = size;
+        }
+        if (received == 0)
+        {
+            received = -1;
+        }
+#endif
+        if (received < 0)
+        {
+            release(datagrams, count);
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EWOULDBLOCK || errno == EAGAIN || total > 0)
+            {
+                break;
+            }
+            return -1;
+        }
+
+        int unused = 0;
+        for (int i = 0; i < count; ++i)
+        {
+            if (batch && i < received && datagrams[i]->size > 0)
+            {
+                batch->push_back(datagrams[i]);
+                ++total;
+            }
+            else
+            {
+                datagrams[unused++] = datagrams[i];
+            }
+        }
+        release(datagrams, unused);
+
+        if (received < count)
+        {
+            break; // socket drained
+        }
+    }
+    return total;
+}
+
+int UdpReceiver::acquire(Datagram** datagrams, int count)
+{
+    std::lock_guard<std::mutex> lg(_locker);
+    for (int i = 0; i < count; ++i)
+    {
+        if (!_free)
+        {
+            if (_chunks.size() >= UDP_POOL_MAX_CHUNKS)
+            {
+                return i;
+            }
+
+            Datagram* chunk = new Datagram[UDP_RECV_BATCH];
+            for (int j = 0; j < UDP_RECV_BATCH; ++j)
+            {
+                chunk[j].next = _free;
+                _free = &chunk[j];
+            }
+            _chunks.push_back(chunk);
+        }
+
+        datagrams[i] = _free;
+        _free = _free->next;
+    }
+    return count;
+}
+
+void UdpReceiver::release(Datagram** datagrams, int count)
+{
+    std::lock_guard<std::mutex> lg(_locker);
+    for (int i = 0; i < count; ++i)
+    {
+        datagrams[i]->next = _free;
+        _free = datagrams[i];
+    }
+}
@@ -0,0 +1,123 @@
+
+/*****************************************************************************
+*                                                                            *
+*  @file     UdpReceiver.h                                                   *
+*  @brief    Native batched RTP/RTCP UDP receiver declaration                *
+*                                                                            *
+*  Details.                                                                  *
+*    Binds the client RTP/RTCP ports itself and drains them with recvmmsg    *
+*    into pooled datagram buffers, bypassing jrtplib's one packet per        *
+*    syscall receive path.                                                   *
+*                                                                            *
+*----------------------------------------------------------------------------*
+*  Remark   :                                                                *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef __UDP_RECEIVER_HEADER_H__
+#define __UDP_RECEIVER_HEADER_H__
+
+#include "Common.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include <stdint.h>
+
+#define UDP_DATAGRAM_SIZE       2048
+#define UDP_RECV_BATCH          32
+
+// batches taken from one socket per Receive, the rest waits for the next wakeup so one busy
+// session cannot starve the others sharing its reactor thread
+#define UDP_RECV_MAX_BATCHES    8
+
+// pool limit in chunks of UDP_RECV_BATCH datagrams, 4 MB
+#define UDP_POOL_MAX_CHUNKS     64
+
+class UdpReceiver
+{
+public:
+    struct Datagram
+    {
+        unsigned char data[UDP_DATAGRAM_SIZE];
+        int size = 0;
+
+        Datagram* next = nullptr;
+    };
+
+public:
+    UdpReceiver();
+    ~UdpReceiver();
+
+    int Create(const Endpoint& client);
+
+    /* Receive from sockets bound elsewhere, e.g. joined to a multicast group. Takes them over, also on failure */
+    int Create(SOCKET rtp_socket, SOCKET rtcp_socket);
+    void Destroy();
+
+    inline SOCKET GetRTPSocket() const { return _rtp_socket; }
+    inline SOCKET GetRTCPSocket() const { return _rtcp_socket; }
+
+    /* Read the RTP socket without blocking, every received datagram is appended to 'batch'
+    * and stays owned by the caller until handed back with Release.
+    * The RTCP socket is read as well, into 'rtcp' if given, otherwise its content is discarded.
+    * At most UDP_RECV_MAX_BATCHES batches are taken per socket, and none while the pool is exhausted,
+    * whatever is left stays queued in the kernel and keeps the socket readable.
+    * return:
+    *    number of RTP datagrams appended, -1 on socket error
+    * */
+    int Receive(std::vector<Datagram*>& batch, std::vector<Datagram*>* rtcp = nullptr);
+
+    /* Take an empty datagram from the pool for data received elsewhere, safe from any thread.
+    * return:
+    *    nullptr if the pool is exhausted
+    * */
+    Datagram* Acquire();
+
+    /* Give a datagram back to the pool, safe from any thread */
+    void Release(Datagram* datagram);
+
+    inline unsigned long long GetTruncatedCount() const { return _truncated; }
+
+    /* Datagrams the kernel dropped because a socket receive queue was full (SO_RXQ_OVFL, Linux only).
+    * The kernel reports the count along with the next datagram it delivers */
+    inline unsigned long long GetOverflowCount() const { return (unsigned long long)_rtp_overflow + _rtcp_overflow; }
+
+    /* Size the receive queue of any socket, beyond net.core.rmem_max where the process is allowed to (SO_RCVBUFFORCE).
+    * return:
+    *    the size the kernel granted, -1 on error
+    * */
+    static int SetReceiveBuffer(SOCKET fd, int bytes);
+
+    /* Datagrams dropped on any socket so far (SO_MEMINFO, Linux only).
+    * return:
+    *    -1 if not supported
+    * */
+    static long long GetSocketDrops(SOCKET fd);
+
+private:
+    int receive(SOCKET fd, std::vector<Datagram*>* batch, std::atomic<uint32_t>& overflow);
+
+    int acquire(Datagram** datagrams, int count);
+    void release(Datagram** datagrams, int count);
+
+private:
+    SOCKET _rtp_socket;
+    SOCKET _rtcp_socket;
+
+private:
+    std::mutex _locker;
+    std::vector<Datagram*> _chunks;
+    Datagram* _free;
+
+    std::atomic<unsigned long long> _truncated;
+    std::atomic<uint32_t> _rtp_overflow;
+    std::atomic<uint32_t> _rtcp_overflow;
+
+private:
+    UdpReceiver(const UdpReceiver& rhs);
+    UdpReceiver& operator=(const UdpReceiver& rhs);
+};
+
+#endif
@@ -43,9 +43,9 @@ ssize_t	ReadLine(int fd, void *vptr, int maxlen)
 			*ptr = 0;
 			return n - 1;
 		} else {
-			if(errno == EINTR)
+			if(LastSocketErrorInterrupted())
 				goto again;
-			else if(errno == EWOULDBLOCK || errno == EAGAIN) 
+			else if(LastSocketErrorWouldBlock()) 
 				return n - 1;
 			return -1;
 		}
@@ -72,9 +72,9 @@ ssize_t Writen(int fd, const void *vptr, int n)
 #else
         if ((nwritten = write(fd, ptr, nleft)) <= 0) {
 #endif
-			if (nwritten < 0 && errno == EINTR)
+			if (nwritten < 0 && LastSocketErrorInterrupted())
 				nwritten = 0;       /* and call write() again */
-			else if(nwritten < 0 && (errno == EWOULDBLOCK || errno == EAGAIN)) 
+			else if(nwritten < 0 && LastSocketErrorWouldBlock()) 
 				return (n - nleft);
 			else
 				return(-1);         /* error */
@@ -104,9 +104,9 @@ ssize_t Readn(int fd, void *vptr, int n)
 #else
         if ((nread = read(fd, ptr, nleft)) < 0) {
 #endif
-			if (errno == EINTR)
+			if (LastSocketErrorInterrupted())
 				nread = 0;      /* and call read() again */
-			else if(errno == EWOULDBLOCK || errno == EAGAIN)
+			else if(LastSocketErrorWouldBlock())
 				return (n - nleft);
 			else
 				return(-1);
@@ -120,6 +120,34 @@ ssize_t Readn(int fd, void *vptr, int n)
 }
 /* end readn */
 
+int LastSocketError()
+{
+#ifdef _MSC_VER
+    return WSAGetLastError();
+#else
+    return errno;
+#endif
+}
+
+bool LastSocketErrorWouldBlock()
+{
+    int error = LastSocketError();
+#ifdef _MSC_VER
+    return error == WSAEWOULDBLOCK || error == WSAEINPROGRESS;
+#else
+    return error == EWOULDBLOCK || error == EAGAIN || error == EINPROGRESS;
+#endif
+}
+
+bool LastSocketErrorInterrupted()
+{
+#ifdef _MSC_VER
+    return WSAGetLastError() == WSAEINTR;
+#else
+    return errno == EINTR;
+#endif
+}
+
 int Md5sum32(void * input, unsigned char * output, size_t input_size, size_t output_size)
 {
 	unsigned char decrypt[16];
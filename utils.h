@@ -60,6 +60,16 @@ ssize_t Readn(int fd, void *vptr, int n);
 ssize_t Writen(int fd, const void *vptr, int n);
 #endif
 
+/* The error of the last failed socket call, WSAGetLastError() on Windows, errno elsewhere */
+int LastSocketError();
+
+/* The last socket call only failed because it would have blocked, a non-blocking connect
+ * still in progress included. Winsock reports these without touching errno */
+bool LastSocketErrorWouldBlock();
+
+/* The last socket call was interrupted by a signal and can be retried */
+bool LastSocketErrorInterrupted();
+
 /*
 param: 
 output: must sizeof(output) >= 32